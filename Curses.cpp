@@ -0,0 +1,88 @@
+#include <ncurses.h>
+#include "Curses.h"
+
+
+/**
+ * Start curses in color, without cursor, scrolling or new lines
+ */
+void Curses::open() {
+    initscr(); /* start curses */
+    start_color(); /* start color mode */
+    curs_set(0); /* hide cursor */
+    scrollok(stdscr, FALSE); /* disallow scroll */
+    nonl(); /* disallow new lines */
+
+    /* Colors: empty / dead, tree / alive, burning */
+    init_pair(0,COLOR_BLACK,COLOR_BLACK);
+    init_pair(1,COLOR_GREEN,COLOR_BLACK);
+    init_pair(2,COLOR_RED,COLOR_BLACK);
+}
+
+
+int Curses::lines() {
+    return LINES;
+}
+
+
+int Curses::cols() {
+    return COLS;
+}
+
+
+void Curses::resize(int rows, int cols) {
+    resizeterm(rows, cols);
+}
+
+
+void Curses::clear() {
+    erase();
+}
+
+
+/**
+ * Draw text
+ * @param row screen row
+ * @param col screen column
+ * @param s text
+ * @param n at most n characters (all if negative)
+ */
+void Curses::text(int row, int col, const char* s, int n) {
+    mvaddnstr(row, col, s, n);
+}
+
+
+/**
+ * Draw one cell
+ * @param row screen row
+ * @param col screen column
+ * @param c character
+ * @param color color pair
+ */
+void Curses::cell(int row, int col, char c, int color) {
+    attron(COLOR_PAIR(color));
+    mvaddch(row, col, c);
+    attroff(COLOR_PAIR(color));
+}
+
+
+void Curses::show() {
+    refresh();
+}
+
+
+/**
+ * Show a closing message, wait for Enter and end curses
+ * @param row screen row
+ * @param col screen column
+ * @param msg message
+ */
+void Curses::close(int row, int col, const char* msg) {
+    curs_set(1);
+    attron(COLOR_PAIR(1));
+    mvaddstr(row, col, msg);
+    attroff(COLOR_PAIR(1));
+    refresh();
+    getch();
+    getch();
+    endwin();
+}
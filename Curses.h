@@ -0,0 +1,21 @@
+#ifndef FOREST_CURSES_H
+#define FOREST_CURSES_H
+
+#include "Screen.h"
+
+/**
+ * Screen drawn with ncurses. Color pair n is used for state n.
+ */
+class Curses : public Screen {
+public:
+    void open();
+    int lines();
+    int cols();
+    void resize(int rows, int cols);
+    void clear();
+    void text(int row, int col, const char* s, int n = -1);
+    void cell(int row, int col, char c, int color);
+    void show();
+    void close(int row, int col, const char* msg);
+};
+#endif //FOREST_CURSES_H
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include "Grid.h"
+
+using namespace std;
+
+
+/**
+ * Constructor. Every cell, including the padding, starts out of bounds.
+ * @param rows local rows
+ * @param width map width
+ * @param halo padding depth
+ * @return Grid object
+ */
+Grid::Grid(int rows, int width, int halo) : Grid(rows, width, halo, nullptr) {
+    _cells = new vector<unsigned char>(bytes(rows, width, halo), OUT_OF_BOUNDS);
+    _cur = _cells->data();
+    _nxt = _cur + bytes(rows, width, halo) / 2;
+}
+
+
+/**
+ * Constructor over caller-supplied storage of bytes(rows, width, halo) cells. The cells
+ * are used as they are; whoever owns the storage initializes it.
+ * @param rows local rows
+ * @param width map width
+ * @param halo padding depth
+ * @param cells storage for both generations
+ * @return Grid object
+ */
+Grid::Grid(int rows, int width, int halo, unsigned char* cells) {
+    _rows = rows;
+    _width = width;
+    _halo = halo;
+    _stride = width + 2 * halo;
+    _cells = nullptr;
+    _cur = cells;
+    _nxt = cells + bytes(rows, width, halo) / 2;
+    _above = nullptr;
+    _below = nullptr;
+}
+
+
+/**
+ * Destructor. Frees the storage if the grid allocated it, and the linked strips.
+ */
+Grid::~Grid() {
+    delete _cells;
+    delete _above;
+    delete _below;
+}
+
+
+/**
+ * Storage taken by a strip
+ * @param rows local rows
+ * @param width map width
+ * @param halo padding depth
+ * @return cells for both generations
+ */
+unsigned long Grid::bytes(int rows, int width, int halo) {
+    return 2 * (unsigned long) (width + 2 * halo) * (unsigned long) (rows + 2 * halo);
+}
+
+
+/**
+ * Read the neighboring strips in place of the halo rows. The linked strips must
+ * step in lockstep with this one; they are swapped and deleted along with it.
+ * @param above strip above (or nullptr to keep the top halo rows)
+ * @param below strip below (or nullptr to keep the bottom halo rows)
+ */
+void Grid::link(Grid* above, Grid* below) {
+    _above = above;
+    _below = below;
+}
+
+
+/**
+ * @return start of the storage of both generations
+ */
+unsigned char* Grid::cells() {
+    return std::min(_cur, _nxt);
+}
+
+
+/**
+ * @return which half of the storage holds the current generation (0 or 1). Strips
+ * that step in lockstep agree on it.
+ */
+int Grid::generation() {
+    return (_cur < _nxt) ? 0 : 1;
+}
+
+
+/**
+ * Pointer to column 0 of a row in the current generation
+ * @param i local row, from -halo to rows + halo - 1
+ * @return row pointer (columns -halo to width + halo - 1 are addressable)
+ */
+unsigned char* Grid::row(int i) {
+    if (i < 0 && _above != nullptr) return _above->row(_above->_rows + i);
+    if (i >= _rows && _below != nullptr) return _below->row(i - _rows);
+    return _cur + (i + _halo) * _stride + _halo;
+}
+
+
+/**
+ * Pointer to column 0 of a row in the next generation
+ * @param i local row
+ * @return row pointer
+ */
+unsigned char* Grid::next_row(int i) {
+    return _nxt + (i + _halo) * _stride + _halo;
+}
+
+
+/**
+ * Status of a cell in the current generation
+ * @param i local row
+ * @param j column
+ * @return int cell status
+ */
+int Grid::get(int i, int j) {
+    return row(i)[j];
+}
+
+
+/**
+ * Set a cell in the current generation
+ * @param i local row
+ * @param j column
+ * @param s status
+ */
+void Grid::set(int i, int j, int s) {
+    row(i)[j] = (unsigned char) s;
+}
+
+
+/**
+ * Fill whole rows of both generations (used for halo rows on the map edge)
+ * @param first first local row
+ * @param count number of rows
+ * @param s status
+ */
+void Grid::fill(int first, int count, int s) {
+    for (int i = first; i < first + count; i++) {
+        for (int j = -_halo; j < _width + _halo; j++) {
+            row(i)[j] = (unsigned char) s;
+            next_row(i)[j] = (unsigned char) s;
+        }
+    }
+}
+
+
+/**
+ * Make the next generation current
+ */
+void Grid::swap() {
+    std::swap(_cur, _nxt);
+    if (_above != nullptr) _above->swap();
+    if (_below != nullptr) _below->swap();
+}
+
+
+int Grid::rows() {
+    return _rows;
+}
+
+int Grid::width() {
+    return _width;
+}
+
+int Grid::halo() {
+    return _halo;
+}
+
+int Grid::stride() {
+    return _stride;
+}
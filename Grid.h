@@ -0,0 +1,45 @@
+#ifndef FOREST_GRID_H
+#define FOREST_GRID_H
+
+#include <vector>
+
+#define OUT_OF_BOUNDS 3   /* state of cells beyond the map edge */
+
+/**
+ * Flat strip of cell states for one rank, padded with `halo` rows above and below
+ * (remote rows or map edge) and `halo` columns left and right (always map edge).
+ * Two generations are kept so that a step reads one buffer and writes the other.
+ * A strip may be linked to the strips above and below it when they live in memory
+ * this process can read (a shared window); their rows then stand in for the halo rows.
+ */
+class Grid {
+    int _rows;     /* local rows */
+    int _width;    /* map width */
+    int _halo;     /* padding depth on every side */
+    int _stride;   /* cells per stored row */
+    std::vector<unsigned char>* _cells; /* storage, unless supplied by the caller */
+    unsigned char* _cur;   /* current generation */
+    unsigned char* _nxt;   /* next generation */
+    Grid* _above;  /* strip read in place of the top halo */
+    Grid* _below;  /* strip read in place of the bottom halo */
+
+public:
+    Grid(int rows, int width, int halo);
+    Grid(int rows, int width, int halo, unsigned char* cells);
+    ~Grid();
+    static unsigned long bytes(int rows, int width, int halo);
+    void link(Grid* above, Grid* below);
+    unsigned char* cells();
+    int generation();
+    unsigned char* row(int i);
+    unsigned char* next_row(int i);
+    int get(int i, int j);
+    void set(int i, int j, int s);
+    void fill(int first, int count, int s);
+    void swap();
+    int rows();
+    int width();
+    int halo();
+    int stride();
+};
+#endif //FOREST_GRID_H
@@ -1,5 +1,4 @@
 #include "Node.h"
-#include "Simulator.h"
 
 using namespace std;
 
@@ -18,6 +17,10 @@ Node::Node(int status, Row* r) {
     _color = 0;
 }
 
+Node::~Node() {
+    delete _n;
+}
+
 int Node::status() {
     return _state;
 }
@@ -43,13 +46,3 @@ array<int,8>* Node::n() {
     return _n;
 }
 
-
-
-ostream& operator << (ostream& o, const Node& n) {
-    o << Simulator::instance()->translate(n._state) ;
-    return o;
-}
-
-string& operator += (string& s, const Node& n) {
-    return s += + Simulator::instance()->translate(n._state);
-}
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "Row.h"
 
 class Row;
+class Screen;
 
 class Node {
     int _state;
@@ -20,15 +21,14 @@ class Node {
 public:
     Node(int status);
     Node(int status, Row* r);
+    ~Node();
     void setn(int i, int s);
     void set(int s, int c);
     void set(int i);
-    void display(int row, int col);
+    void display(Screen* screen, int row, int col, char c);
     std::array<int,8>* n();
     int status();
     int color();
-    friend std::ostream& operator<<(std::ostream&, const Node&);
-    friend std::string& operator+=(std::string&, const Node&);
 };
 
 
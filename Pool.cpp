@@ -0,0 +1,83 @@
+//
+// Replica pool: many independent simulations at once in one process, one per thread at
+// a time. Nothing is shared between simulations (each State owns its Simulator, RNG and
+// buffers), so threads take the next simulation from a shared counter and run it to the
+// end on their own communicator without locks.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "defs.h"
+#include "Pool.h"
+
+using namespace std;
+
+
+/**
+ * Constructor
+ * @param threads threads to run on (0: one per hardware thread)
+ * @return Pool object
+ */
+Pool::Pool(int threads) {
+    init_mpi();
+    int provided;
+    MPI_Query_thread(&provided);
+    if (threads <= 0) threads = max(1, (int) thread::hardware_concurrency());
+    if (provided < MPI_THREAD_MULTIPLE) threads = 1;
+    _comms = new vector<MPI_Comm>((unsigned long) threads);
+    for (MPI_Comm& c : *_comms) MPI_Comm_dup(MPI_COMM_SELF, &c);
+}
+
+
+Pool::~Pool() {
+    int done;
+    MPI_Finalized(&done);
+    if (!done) for (MPI_Comm& c : *_comms) MPI_Comm_free(&c);
+    delete _comms;
+}
+
+
+/**
+ * @return threads the simulations run on
+ */
+int Pool::threads() {
+    return (int) _comms->size();
+}
+
+
+/**
+ * Runs every simulation for a number of generations. The calling thread works too.
+ * @param sims .sim text of each simulation
+ * @param generations generations to step each
+ * @return statistics of each simulation at the end, in the order given
+ * @throws the first error a simulation threw, once all have finished
+ */
+vector<Stats> Pool::run(const vector<string>& sims, int generations) {
+    vector<Stats> out(sims.size());
+    atomic<unsigned long> next(0);
+    exception_ptr error;
+    mutex lock;
+    auto work = [&](MPI_Comm comm) {
+        for (unsigned long k = next++; k < sims.size(); k = next++) {
+            try {
+                Simulation s(sims[k], comm);
+                s.step(generations);
+                out[k] = s.stats();
+            } catch (...) {
+                lock_guard<mutex> hold(lock);
+                if (!error) error = current_exception();
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (unsigned long t = 1; t < _comms->size() && t < sims.size(); t++) pool.emplace_back(work, _comms->at(t));
+    work(_comms->front());
+    for (thread& t : pool) t.join();
+    if (error) rethrow_exception(error);
+    return out;
+}
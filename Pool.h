@@ -0,0 +1,25 @@
+#ifndef FOREST_POOL_H
+#define FOREST_POOL_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include "Simulation.h"
+
+/**
+ * Runs independent simulations (replicas) side by side on threads of this process. Every
+ * simulation has its own State and rules, and every thread its own communicator over
+ * MPI_COMM_SELF, so the threads share nothing and throughput grows with the cores. MPI is
+ * initialized with MPI_THREAD_MULTIPLE if the program has not done it; a program that
+ * initialized it with less thread support gets one thread.
+ */
+class Pool {
+    std::vector<MPI_Comm>* _comms;  /* one per thread */
+
+public:
+    Pool(int threads = 0);
+    ~Pool();
+    int threads();
+    std::vector<Stats> run(const std::vector<std::string>& sims, int generations);
+};
+#endif //FOREST_POOL_H
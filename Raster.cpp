@@ -0,0 +1,91 @@
+//
+// Probability rasters (ignition map, growth map: <file>).
+//
+// Each rank maps only the rows of the file it steps (its strip and, for the blocked
+// engine, the halo rows a block reaches) with one read-only mmap, rounded down to a page
+// boundary. The kernel pages the rows in on first use and the ranks of a node share
+// them in the page cache, so no rank reads or holds a private copy of the file. Floats
+// or bytes, told apart by the file size, are read in place.
+//
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "defs.h"
+#include "Raster.h"
+
+using namespace std;
+
+
+/**
+ * Constructor. Maps global rows [first, first + rows) of the file.
+ * @param file raster file
+ * @param height map height
+ * @param width map width
+ * @param first first row mapped
+ * @param rows rows mapped
+ * @param p probability a byte value of 255 stands for
+ * @return Raster object
+ */
+Raster::Raster(const string& file, int height, int width, long first, int rows, double p) {
+    _addr = nullptr;
+    _length = 0;
+    _floats = nullptr;
+    _bytes = nullptr;
+    _scale = p / 255;
+    _first = first;
+    _rows = rows;
+    _width = width;
+
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        throw runtime_error(ERROR_RASTER);
+    }
+    long cells = (long) height * width;
+    long size = (st.st_size == cells * (long) sizeof(float)) ? (long) sizeof(float) : (st.st_size == cells) ? 1 : 0;
+    if (size == 0 || rows <= 0) {
+        close(fd);
+        if (size == 0) throw runtime_error(ERROR_RASTER);
+        return;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    long from = first * width * size, to = (first + rows) * width * size;
+    long base = from / page * page;
+    _length = (unsigned long) (to - base);
+    _addr = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, base);
+    close(fd);
+    if (_addr == MAP_FAILED) {
+        _addr = nullptr;
+        throw runtime_error(ERROR_RASTER);
+    }
+    const unsigned char* cells0 = (const unsigned char*) _addr + (from - base);
+    if (size == 1) _bytes = cells0;
+    else _floats = (const float*) cells0;
+}
+
+
+Raster::~Raster() {
+    if (_addr != nullptr) munmap(_addr, _length);
+}
+
+
+/**
+ * @param from first global row, mapped
+ * @param to end row
+ * @return highest probability of the rows
+ */
+double Raster::max(long from, long to) const {
+    double top = 0;
+    for (long i = from; i < to; i++) {
+        for (long j = 0; j < _width; j++) {
+            double p = at(i, j);
+            if (p > top) top = p;
+        }
+    }
+    return top;
+}
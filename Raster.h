@@ -0,0 +1,38 @@
+#ifndef FOREST_RASTER_H
+#define FOREST_RASTER_H
+
+#include <string>
+
+/**
+ * Per-cell probabilities from a binary file of height x width cells, row by row, with no
+ * header: 4-byte floats (native byte order) holding the probability itself, or bytes
+ * holding a fraction value / 255 of the .sim probability
+ */
+class Raster {
+    void* _addr;                 /* mapping (page aligned) */
+    unsigned long _length;       /* bytes mapped */
+    const float* _floats;        /* first mapped row (float raster) */
+    const unsigned char* _bytes; /* first mapped row (byte raster) */
+    double _scale;               /* probability of byte value 1 */
+    long _first;                 /* global row of the first mapped row */
+    int _rows;                   /* rows mapped */
+    int _width;                  /* map width */
+
+public:
+    Raster(const std::string& file, int height, int width, long first, int rows, double p);
+    ~Raster();
+    double max(long from, long to) const;
+
+    /**
+     * @param row global row, mapped
+     * @param col column
+     * @return probability of the cell
+     */
+    double at(long row, long col) const {
+        long k = (row - _first) * _width + col;
+        if (_floats == nullptr) return _bytes[k] * _scale;
+        double p = _floats[k];
+        return (p > 0) ? ((p < 1) ? p : 1) : 0;   /* also maps NaN to 0 */
+    }
+};
+#endif //FOREST_RASTER_H
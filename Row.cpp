@@ -48,6 +48,16 @@ Row::Row(vector<string>* map, int r) {
 }
 
 
+/**
+ * Destructor. The row owns its nodes.
+ */
+Row::~Row() {
+    for (Node* n : *_nodev) delete n;
+    delete _nodev;
+    delete _intv;
+}
+
+
 /**
  * Add node to node vector
  * @param n node
@@ -57,6 +67,30 @@ void Row::push(Node* n) {
 }
 
 
+/**
+ * Overwrite every node state in place from an int array (no allocation)
+ * @param i int array of row size
+ */
+void Row::set(int* i) {
+    for (unsigned long j = 0; j < _nodev->size(); j++) {
+        _nodev->at(j)->set(i[j], i[j]);
+        _intv->at(j) = i[j];
+    }
+}
+
+
+/**
+ * Overwrite every node state in place from a byte array (no allocation)
+ * @param i byte array of row size
+ */
+void Row::set(unsigned char* i) {
+    for (unsigned long j = 0; j < _nodev->size(); j++) {
+        _nodev->at(j)->set(i[j], i[j]);
+        _intv->at(j) = i[j];
+    }
+}
+
+
 /**
  * Get node from node vector
  * @param i node index
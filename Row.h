@@ -13,10 +13,13 @@ class Row {
 public:
     Row(int* i, int size);
     Row(std::vector<std::string>* map, int r);
+    ~Row();
     std::vector<int>* get_intv();
     std::vector<Node*>* get_nodev();
     Node* get_node(int i);
     void push(Node* n);
+    void set(int* i);
+    void set(unsigned char* i);
     int get(int i);
     void sync();
 };
@@ -0,0 +1,101 @@
+#include <cmath>
+#include <algorithm>
+#include "Sampler.h"
+#include "defs.h"
+
+using namespace std;
+
+
+/**
+ * Seed of an independent draw stream
+ * @param seed run seed
+ * @param stream stream id
+ * @return unsigned long
+ */
+unsigned long stream_seed(unsigned long seed, int stream) {
+    return seed ^ (0x9e3779b97f4a7c15UL * (unsigned long) (stream + 1));
+}
+
+
+/**
+ * Constructor
+ * @param seed run seed
+ * @param stream stream id
+ * @param p event probability per cell (clamped to [0,1])
+ * @return Sampler object
+ */
+Sampler::Sampler(unsigned long seed, int stream, double p) {
+    _seed = stream_seed(seed, stream);
+    _p = min(1.0, max(0.0, p));
+    _scale = (_p > 0 && _p < 1) ? 1.0 / log(1.0 - _p) : 0;
+    _gen = _row = _to = _chunk = _k = 0;
+    _next = 0;
+}
+
+
+/**
+ * Position the cursor on the first event at or after a column
+ * @param gen generation
+ * @param row global row
+ * @param from first column
+ * @param to end column (next() returns at least this once the span is exhausted)
+ */
+void Sampler::seek(long gen, long row, long from, long to) {
+    _gen = gen;
+    _row = row;
+    _to = to;
+    _chunk = from / RNG_CHUNK;
+    _k = 0;
+    _next = _chunk * RNG_CHUNK - 1;
+    advance();
+    while (_next < from) advance();
+}
+
+
+/**
+ * @return column of the next event, or >= the end column if there is none
+ */
+long Sampler::next() {
+    return _next;
+}
+
+
+/**
+ * Move the cursor to the following event. Each draw is a geometric gap, the
+ * number of failed trials before the next success.
+ */
+void Sampler::advance() {
+    if (_p <= 0) { _next = _to; return; }
+    while (true) {
+        long gap = 0;
+        if (_p < 1) {
+            double u = toss_at(_seed, _gen, _row, _chunk, _k++);
+            gap = (long) min(floor(log(1.0 - u) * _scale), (double) RNG_CHUNK);
+        }
+        _next += 1 + gap;
+        if (_next < (_chunk + 1) * RNG_CHUNK) return;
+        _chunk++;
+        _k = 0;
+        _next = _chunk * RNG_CHUNK - 1;
+        if (_next + 1 >= _to) { _next = max(_to, _next + 1); return; }
+    }
+}
+
+
+/**
+ * Whether an event falls on a column. Columns must be queried in increasing order.
+ * @param col column
+ * @return bool
+ */
+bool Sampler::hit(long col) {
+    while (_next < col) advance();
+    return _next == col;
+}
+
+
+/**
+ * @return event probability per cell
+ */
+double Sampler::p() {
+    return _p;
+}
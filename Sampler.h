@@ -0,0 +1,38 @@
+#ifndef FOREST_SAMPLER_H
+#define FOREST_SAMPLER_H
+
+#define RNG_CHUNK 64          /* columns per independently keyed draw sequence */
+#define STREAM_LIGHTNING 1    /* lightning strikes */
+#define STREAM_GROWTH 2       /* regrowth candidates */
+#define STREAM_ACCEPT 3       /* regrowth acceptance (per cell) */
+#define STREAM_STRIKE 4       /* lightning acceptance (per cell, probability rasters) */
+#define STREAM_MAP 5          /* initial map (per cell) */
+
+/**
+ * Geometric skip-sampler for rare per-cell events. Instead of one Bernoulli draw per
+ * cell, it draws the gap to the next success and jumps straight to it. Draws are keyed
+ * on (seed, stream, generation, row, chunk of RNG_CHUNK columns), so any rank or tile
+ * that samples the same row span sees the same events.
+ */
+class Sampler {
+    unsigned long _seed;  /* run seed mixed with the stream */
+    double _p;            /* event probability per cell */
+    double _scale;        /* 1 / log(1 - p) */
+    long _gen;            /* generation */
+    long _row;            /* global row */
+    long _to;             /* end column */
+    long _chunk;          /* chunk of the cursor */
+    long _k;              /* draws made in the chunk */
+    long _next;           /* column of the next event */
+
+public:
+    Sampler(unsigned long seed, int stream, double p);
+    void seek(long gen, long row, long from, long to);
+    long next();
+    void advance();
+    bool hit(long col);
+    double p();
+};
+
+unsigned long stream_seed(unsigned long seed, int stream);
+#endif //FOREST_SAMPLER_H
@@ -0,0 +1,22 @@
+#ifndef FOREST_SCREEN_H
+#define FOREST_SCREEN_H
+
+/**
+ * Terminal the master process draws the simulation on. The engine only talks to this
+ * interface; the curses implementation (Curses) is linked into the forest binary, not
+ * into the library, and embedded simulations run without a screen.
+ */
+class Screen {
+public:
+    virtual ~Screen() {}
+    virtual void open() = 0;                                  /* take over the terminal */
+    virtual int lines() = 0;                                  /* terminal rows */
+    virtual int cols() = 0;                                   /* terminal columns */
+    virtual void resize(int rows, int cols) = 0;              /* resize the drawing area */
+    virtual void clear() = 0;                                 /* blank the frame */
+    virtual void text(int row, int col, const char* s, int n = -1) = 0;  /* plain text, at most n chars */
+    virtual void cell(int row, int col, char c, int color) = 0;         /* one colored cell */
+    virtual void show() = 0;                                  /* put the frame on the terminal */
+    virtual void close(int row, int col, const char* msg) = 0; /* show msg, wait for Enter, give the terminal back */
+};
+#endif //FOREST_SCREEN_H
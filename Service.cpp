@@ -0,0 +1,258 @@
+//
+// Service mode (forest --serve <socket>).
+//
+// Master listens on a Unix stream socket. A client sends jobs as
+//
+//     job <bytes>
+//     <.sim text, exactly <bytes> bytes>
+//
+// and gets one line back per job, on the same connection, once it has run:
+//
+//     ok <generations> <fingerprint> <cells per state> <period> <seconds>
+//     error <message>
+//
+// Output files (frames, cluster census) are named by options in the .sim text. Master
+// broadcasts every job and all ranks build and run it headless, on a communicator
+// duplicated once for the whole service, so a job costs no process launch, MPI
+// initialization or screen setup. A job of the blocked engine takes over the strip and
+// windows of the job before when they have the same shape. `quit` answers
+// `bye <jobs> <jobs per second>` and ends the service.
+//
+
+#include <mpi.h>
+#include <climits>
+#include <iostream>
+#include <stdexcept>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "defs.h"
+#include "Service.h"
+#include "State.h"
+
+using namespace std;
+
+#define JOB_QUIT -1    /* broadcast length that ends the service */
+
+
+/**
+ * Constructor. Master binds the socket, replacing a stale one. Collective.
+ * @param path socket path
+ * @param comm ranks running the jobs
+ * @return Service object
+ */
+Service::Service(const string& path, MPI_Comm comm) {
+    MPI_Comm_dup(comm, &_comm);
+    MPI_Comm_rank(_comm, &_rank);
+    _path = path;
+    _listen = -1;
+    _conn = -1;
+    _job = new vector<char>();
+    _jobs = 0;
+    _failed = 0;
+    _reused = 0;
+    _spare = nullptr;
+    _busy = 0;
+    int ok = 1;
+    if (_rank == 0) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        ok = path.size() < sizeof(addr.sun_path);
+        if (ok) {
+            path.copy(addr.sun_path, path.size());
+            unlink(path.c_str());
+            _listen = socket(AF_UNIX, SOCK_STREAM, 0);
+            ok = _listen >= 0 && bind(_listen, (sockaddr*) &addr, sizeof(addr)) == 0 && listen(_listen, 16) == 0;
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, _comm);
+    if (!ok) {
+        if (_listen >= 0) close(_listen);
+        MPI_Comm_free(&_comm);
+        delete _job;
+        throw runtime_error(ERROR_SOCKET);
+    }
+    _start = MPI_Wtime();
+}
+
+
+/**
+ * Destructor. Closes and removes the socket. Collective.
+ */
+Service::~Service() {
+    delete _spare;
+    if (_conn >= 0) close(_conn);
+    if (_listen >= 0) {
+        close(_listen);
+        unlink(_path.c_str());
+    }
+    delete _job;
+    MPI_Comm_free(&_comm);
+}
+
+
+/**
+ * Reads one line from the client, without its newline (master)
+ * @param line line read
+ * @return false if the client hung up first
+ */
+bool Service::read_line(string& line) {
+    char buf[4096];
+    unsigned long end;
+    while ((end = _in.find('\n')) == string::npos) {
+        long n = read(_conn, buf, sizeof(buf));
+        if (n <= 0) return false;
+        _in.append(buf, (unsigned long) n);
+    }
+    line = _in.substr(0, end);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    _in.erase(0, end + 1);
+    return true;
+}
+
+
+/**
+ * Reads n bytes from the client (master)
+ * @param n bytes
+ * @param out bytes read
+ * @return false if the client hung up first
+ */
+bool Service::read_bytes(long n, string& out) {
+    char buf[4096];
+    while ((long) _in.size() < n) {
+        long k = read(_conn, buf, sizeof(buf));
+        if (k <= 0) return false;
+        _in.append(buf, (unsigned long) k);
+    }
+    out = _in.substr(0, (unsigned long) n);
+    _in.erase(0, (unsigned long) n);
+    return true;
+}
+
+
+/**
+ * Waits for the next job, accepting clients as they come and answering malformed
+ * requests (master)
+ * @return bytes of the job, now in _job, or JOB_QUIT
+ */
+int Service::next_job() {
+    while (true) {
+        if (_conn < 0) {
+            _conn = accept(_listen, nullptr, nullptr);
+            _in.clear();
+            if (_conn < 0) continue;
+        }
+        string line, text;
+        if (!read_line(line)) {
+            close(_conn);
+            _conn = -1;
+            continue;
+        }
+        if (line.empty()) continue;
+        if (line == "quit") return JOB_QUIT;
+        long n = -1;
+        istringstream words(line);
+        string verb;
+        words >> verb >> n;
+        if (verb != "job" || n < 0 || n > INT_MAX) {
+            reply(string("error ") + ERROR_JOB);
+            continue;
+        }
+        if (!read_bytes(n, text)) {
+            close(_conn);
+            _conn = -1;
+            continue;
+        }
+        _job->assign(text.begin(), text.end());
+        return (int) n;
+    }
+}
+
+
+/**
+ * Sends one line to the client, if it is still connected (master)
+ * @param line line without its newline
+ */
+void Service::reply(const string& line) {
+    if (_conn < 0) return;
+    string out = line + "\n";
+    if (send(_conn, out.data(), out.size(), MSG_NOSIGNAL) != (long) out.size()) {
+        close(_conn);
+        _conn = -1;
+    }
+}
+
+
+/**
+ * Runs the job in _job to its last generation. Collective.
+ * @return answer line (meaningful on master)
+ */
+string Service::run_job() {
+    double t = MPI_Wtime();
+    istringstream text(string(_job->begin(), _job->end()));
+    State* spare = _spare;
+    State* s;
+    _spare = nullptr;
+    try {
+        s = new State(text, _comm, nullptr, spare);
+    } catch (exception& e) {
+        if (spare != nullptr && spare->_grid != nullptr) _spare = spare;
+        else delete spare;
+        _failed++;
+        return string("error ") + e.what();
+    }
+    if (spare != nullptr && spare->_grid == nullptr) _reused++;
+    delete spare;
+    try {
+        while (s->running()) {
+            s->transmit_nodes();
+            s->update_neighbors();
+            s->apply_simulation();
+            s->inc_n();
+        }
+    } catch (exception& e) {   /* every rank fails together, e.g. an unwritable frame file */
+        delete s;
+        _failed++;
+        return string("error ") + e.what();
+    }
+    unsigned long sums[1 + VIEW_STATES];
+    s->fingerprint(sums);
+    ostringstream out;
+    out << "ok " << s->_current - 1 << " " << hex << sums[0] << dec;
+    for (int k = 1; k <= VIEW_STATES; k++) out << " " << sums[k];
+    out << " " << s->_period;
+    s->release();
+    if (s->_grid != nullptr && s->_engine == ENGINE_BLOCKED) _spare = s;   /* its strip may serve the next job */
+    else delete s;
+    t = MPI_Wtime() - t;
+    out << " " << t;
+    _busy += t;
+    _jobs++;
+    return out.str();
+}
+
+
+/**
+ * Serves jobs until a client sends quit, then reports the throughput. Collective.
+ */
+void Service::run() {
+    if (_rank == 0) cout << "Serving on " << _path << endl;
+    while (true) {
+        int n = (_rank == 0) ? next_job() : 0;
+        MPI_Bcast(&n, 1, MPI_INT, 0, _comm);
+        if (n == JOB_QUIT) break;
+        _job->resize((unsigned long) n);
+        MPI_Bcast(_job->data(), n, MPI_CHAR, 0, _comm);
+        string answer = run_job();
+        if (_rank == 0) reply(answer);
+    }
+    double wall = MPI_Wtime() - _start;
+    ostringstream bye;
+    bye << "bye " << _jobs << " " << _jobs / wall;
+    if (_rank == 0) {
+        reply(bye.str());
+        cout << "Served:      " << _jobs << " jobs (" << _failed << " rejected, " << _reused << " on a reused strip) in " << wall << " s, "
+             << _jobs / wall << " jobs/s, " << _busy / wall * 100 << "% busy" << endl;
+    }
+}
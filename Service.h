@@ -0,0 +1,41 @@
+#ifndef FOREST_SERVICE_H
+#define FOREST_SERVICE_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+class State;
+
+/**
+ * Long-lived simulation service: master listens on a Unix socket for jobs (.sim text),
+ * every rank runs each job headless on the same communicator, and master answers on the
+ * connection the job came from. One launch serves any number of jobs.
+ */
+class Service {
+    MPI_Comm _comm;      /* ranks running the jobs */
+    int _rank;
+    std::string _path;   /* socket path (master) */
+    int _listen;         /* listening socket (master) */
+    int _conn;           /* connected client, or -1 (master) */
+    std::string _in;     /* bytes received and not yet read (master) */
+    std::vector<char>* _job;  /* text of the current job */
+    long _jobs;          /* jobs run */
+    long _failed;        /* jobs rejected */
+    long _reused;        /* jobs that took over the strip of the job before */
+    State* _spare;       /* last job, released but for its strip */
+    double _busy;        /* seconds spent running jobs */
+    double _start;       /* MPI_Wtime when the service started */
+
+    bool read_line(std::string& line);
+    bool read_bytes(long n, std::string& out);
+    int next_job();
+    void reply(const std::string& line);
+    std::string run_job();
+
+public:
+    Service(const std::string& path, MPI_Comm comm);
+    ~Service();
+    void run();
+};
+#endif //FOREST_SERVICE_H
@@ -0,0 +1,187 @@
+//
+// Library entry point: simulations built from a Config or .sim text and stepped from
+// code, without a screen and without launching a process per run.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include "defs.h"
+#include "Simulation.h"
+#include "State.h"
+
+using namespace std;
+
+
+/**
+ * Default settings: the forest fire of the bundled examples
+ * @return Config object
+ */
+Config::Config() {
+    mode = 1;
+    height = 50;
+    width = 150;
+    ignition = 0.001;
+    growth = 0.01;
+    underpopulation = 2;
+    overpopulation = 3;
+    reproduction = 3;
+    radius = 5;            /* Bosco's rule */
+    birth_min = 34;
+    birth_max = 45;
+    survival_min = 33;
+    survival_max = 57;
+    density = 0.05;
+}
+
+
+/**
+ * @return the settings as .sim text
+ */
+string Config::sim() const {
+    ostringstream s;
+    s.precision(17);
+    s << "mode:\n" << mode << "\nheight:\n" << height << "\nwidth:\n" << width << "\ngenerations:\n1\n";
+    if (mode == 1) s << "ignition:\n" << ignition << "\ngrowth:\n" << growth << "\n";
+    else if (mode == 3) s << "radius:\n" << radius << "\nbirth min:\n" << birth_min << "\nbirth max:\n" << birth_max
+                          << "\nsurvival min:\n" << survival_min << "\nsurvival max:\n" << survival_max << "\n";
+    else s << "underpopulation:\n" << underpopulation << "\noverpopulation:\n" << overpopulation
+           << "\ngrowth:\n" << reproduction << "\n";
+    s << "init density:\n" << density << "\n";
+    for (const pair<string,string>& o : options) s << o.first << ":\n" << o.second << "\n";
+    return s.str();
+}
+
+
+/**
+ * Finalize MPI at exit if the library initialized it
+ */
+static void finalize() {
+    int done;
+    MPI_Finalized(&done);
+    if (!done) MPI_Finalize();
+}
+
+
+/**
+ * Initialize MPI unless the embedding program has, with the thread support replica
+ * pools need
+ */
+void init_mpi() {
+    int ready, provided;
+    MPI_Initialized(&ready);
+    if (ready) return;
+    MPI_Init_thread(nullptr, nullptr, MPI_THREAD_MULTIPLE, &provided);
+    atexit(finalize);
+}
+
+
+/**
+ * Constructor from settings
+ * @param config settings
+ * @param comm ranks sharing the simulation
+ * @return Simulation object
+ */
+Simulation::Simulation(const Config& config, MPI_Comm comm) : Simulation(config.sim(), comm) {
+}
+
+
+/**
+ * Constructor from .sim text. The generation count in the text is ignored; the
+ * simulation runs as far as it is stepped.
+ * @param sim .sim text
+ * @param comm ranks sharing the simulation
+ * @return Simulation object
+ */
+Simulation::Simulation(const string& sim, MPI_Comm comm) {
+    init_mpi();
+    istringstream text(sim);
+    _state = new State(text, comm);
+}
+
+
+Simulation::~Simulation() {
+    delete _state;
+}
+
+
+/**
+ * Advance n generations
+ * @param n generations
+ */
+void Simulation::step(int n) {
+    if (n > 0) _state->advance(n);
+}
+
+
+/**
+ * @return view of the local strip
+ */
+View Simulation::view() {
+    State* s = _state;
+    if (s->_engine == ENGINE_SPARSE) s->sync_sparse();
+    View v;
+    v.rows = (s->_start < 0) ? 0 : s->_end - s->_start;
+    v.width = s->_width;
+    v.first = max(0, s->_start);
+    if (s->_grid != nullptr) {
+        v.cells = s->_grid->row(0);
+        v.stride = s->_grid->stride();
+        return v;
+    }
+    for (int i = 0; i < v.rows; i++) {
+        for (int j = 0; j < v.width; j++) s->_strip->at((unsigned long) (i * v.width + j)) = (unsigned char) s->get_node_status(i, j);
+    }
+    v.cells = s->_strip->data();
+    v.stride = v.width;
+    return v;
+}
+
+
+/**
+ * @return statistics of the whole map
+ */
+Stats Simulation::stats() {
+    Stats st;
+    if (_state->_engine == ENGINE_SPARSE) {
+        unsigned long sums[1 + VIEW_STATES];
+        _state->fingerprint(sums);
+        for (int k = 0; k < 3; k++) st.cells[k] = (long) sums[1 + k];
+    }
+    else {
+        View v = view();
+        long cells[3] = {0, 0, 0};
+        for (int i = 0; i < v.rows; i++) {
+            for (int j = 0; j < v.width; j++) cells[v.at(i, j)]++;
+        }
+        MPI_Allreduce(cells, st.cells, 3, MPI_LONG, MPI_SUM, _state->_comm);
+    }
+    st.generation = _state->_current - 1;
+    st.period = _state->_period;
+    st.onset = _state->_onset;
+    MPI_Allreduce(&_state->_wire_sent, &st.wire_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, _state->_comm);
+    MPI_Allreduce(&_state->_halo_time, &st.halo_seconds, 1, MPI_DOUBLE, MPI_MAX, _state->_comm);
+    return st;
+}
+
+
+/**
+ * Reads a rectangle of the current generation; only the ranks holding its rows send.
+ * Zoomed out, each cell of the result is the state its zoom x zoom block reduces to.
+ * @param row first row
+ * @param col first column
+ * @param rows rows, within the map
+ * @param cols columns, within the map
+ * @param zoom map cells per result cell edge
+ * @param out ceil(rows / zoom) x ceil(cols / zoom) states (rank 0)
+ */
+void Simulation::region(int row, int col, int rows, int cols, int zoom, unsigned char* out) {
+    State* s = _state;
+    if (row < 0 || col < 0 || rows < 1 || cols < 1 || zoom < 1 || row + rows > s->_height || col + cols > s->_width) {
+        throw runtime_error(ERROR_REGION);
+    }
+    int q[5] = {row, col, rows, cols, zoom};
+    s->region(q, out);
+}
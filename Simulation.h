@@ -0,0 +1,80 @@
+#ifndef FOREST_SIMULATION_H
+#define FOREST_SIMULATION_H
+
+#include <mpi.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class State;
+
+/**
+ * Settings of a simulation, the same as in a .sim file
+ */
+struct Config {
+    int mode;              /* 1 forest fire, 2 Conway's Game of Life, 3 Larger than Life */
+    int height;            /* map height */
+    int width;             /* map width */
+    double ignition;       /* ignition probability (forest fire) */
+    double growth;         /* growth probability (forest fire) */
+    int underpopulation;   /* Conway's Game of Life */
+    int overpopulation;
+    int reproduction;
+    int radius;            /* Larger than Life */
+    int birth_min;
+    int birth_max;
+    int survival_min;
+    int survival_max;
+    double density;        /* initial density */
+    std::vector<std::pair<std::string,std::string>> options;  /* optional settings, e.g. {"engine", "blocked"} */
+
+    Config();
+    std::string sim() const;
+};
+
+/**
+ * Read-only view of the local strip of the current generation. It points into the
+ * engine's own cells (the node engine's are first copied to a flat buffer) and is valid
+ * until the next step().
+ */
+struct View {
+    const unsigned char* cells;  /* local row 0, column 0 */
+    int rows;                    /* local rows */
+    int width;                   /* columns */
+    int stride;                  /* cells from one row to the next */
+    int first;                   /* global row of local row 0 */
+
+    int at(int i, int j) const { return cells[i * stride + j]; }
+};
+
+/**
+ * Statistics of the whole map (same on every rank)
+ */
+struct Stats {
+    long generation;           /* generations completed */
+    long cells[3];             /* cells per state (engine: sparse, of the tiles held) */
+    unsigned long wire_bytes;  /* bytes of cells sent between ranks */
+    double halo_seconds;       /* time in halo exchanges (slowest rank) */
+    int period;                /* period of the steady state found (0 if none) */
+    int onset;                 /* first generation of the steady state */
+};
+
+/**
+ * A simulation driven from code. No screen is attached. The simulation runs on the
+ * ranks of the given communicator (by default each process alone); every call is
+ * collective over it, destruction included. MPI is initialized if it is not yet.
+ * Errors in the settings throw std::runtime_error.
+ */
+class Simulation {
+    State* _state;
+
+public:
+    Simulation(const Config& config, MPI_Comm comm = MPI_COMM_SELF);
+    Simulation(const std::string& sim, MPI_Comm comm = MPI_COMM_SELF);
+    ~Simulation();
+    void step(int n = 1);
+    View view();
+    Stats stats();
+    void region(int row, int col, int rows, int cols, int zoom, unsigned char* out);
+};
+#endif //FOREST_SIMULATION_H
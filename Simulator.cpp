@@ -4,29 +4,65 @@
 #include "State.h"
 #include "Node.h"
 #include <tuple>
-#include <ncurses.h>
 
 using namespace std;
 
-/* Method declarations */
-void forest_fire(Node* n);
-void conway(Node* n);
-
-
-/* RNG */
-random_device rd;    /* seed for RNG */
-mt19937 gen(rd());   /* mersenne twister (RNG) */
-
-
 Simulator::Simulator() {
     _mode = 0;
     _ctrlv = new ctrlv();
     _langv = new langv();
+    _palette = new vector<unsigned int>();
+    _seed = 0;
+    _lightning = nullptr;
+    _growth = nullptr;
+    _ignition_map = nullptr;
+    _growth_map = nullptr;
+    _gen = 0;
+    _row = 0;
+    _table = nullptr;
+}
+
+
+Simulator::~Simulator() {
+    reset();
+    delete _ctrlv;
+    delete _langv;
+    delete _palette;
+}
+
+
+/**
+ * Seed for keyed draws and the map RNG (set before the simulation), so that generated
+ * maps can be reproduced
+ * @param s run seed
+ */
+void Simulator::set_seed(unsigned long s) {
+    _seed = s;
+    _rng.seed((mt19937::result_type) s);
+}
+
+
+/**
+ * Forget the rules of the previous simulation (the simulator outlives embedded runs)
+ */
+void Simulator::reset() {
+    _ctrlv->clear();
+    _langv->clear();
+    _palette->clear();
+    delete _lightning;
+    delete _growth;
+    _lightning = nullptr;
+    _growth = nullptr;
+    _ignition_map = nullptr;
+    _growth_map = nullptr;
+    delete _table;
+    _table = nullptr;
 }
 
 
 void Simulator::set_forest(double i, double g) {
 
+    reset();
     _name = "Forest Fire";
     _mode = 1;
 
@@ -36,17 +72,62 @@ void Simulator::set_forest(double i, double g) {
     _ctrlv->push_back(ignition);
     _ctrlv->push_back(growth);
 
+    /* Event samplers: regrowth candidates at the highest rate g*(8+1), thinned per cell */
+    _lightning = new Sampler(_seed, STREAM_LIGHTNING, i);
+    _growth = new Sampler(_seed, STREAM_GROWTH, 9 * g);
+
     /* Language */
     for (char c : {' ','T','X'}) _langv->push_back(c);
+    for (unsigned int c : {0x000000, 0x1e9e1e, 0xe0301e}) _palette->push_back(c);
+}
+
 
-    /* Colors */
-    init_pair(0,COLOR_BLACK,COLOR_BLACK);
-    init_pair(1,COLOR_GREEN,COLOR_BLACK);
-    init_pair(2,COLOR_RED,COLOR_BLACK);
+/**
+ * Per-cell forest probabilities. Events are drawn at the highest probability of the map
+ * and each is kept with the probability of its cell.
+ * @param ignition ignition probability raster (nullptr: uniform)
+ * @param i highest ignition probability of the map
+ * @param growth growth probability raster (nullptr: uniform)
+ * @param g highest growth probability of the map
+ */
+void Simulator::set_terrain(const Raster* ignition, double i, const Raster* growth, double g) {
+    _ignition_map = ignition;
+    _growth_map = growth;
+    delete _lightning;
+    delete _growth;
+    _lightning = new Sampler(_seed, STREAM_LIGHTNING, i);
+    _growth = new Sampler(_seed, STREAM_GROWTH, 9 * g);
+}
+
+
+const Raster* Simulator::ignition_map() {
+    return _ignition_map;
+}
+
+
+const Raster* Simulator::growth_map() {
+    return _growth_map;
+}
+
+
+/**
+ * @return probability per cell of a lightning candidate
+ */
+double Simulator::lightning_rate() {
+    return _lightning->p();
+}
+
+
+/**
+ * @return probability per cell of a regrowth candidate
+ */
+double Simulator::growth_rate() {
+    return _growth->p();
 }
 
 void Simulator::set_conway(int a, int b, int c) {
 
+    reset();
     _name = "Conway's Game of Life";
     _mode = 2;
 
@@ -60,24 +141,86 @@ void Simulator::set_conway(int a, int b, int c) {
 
     /* Language */
     for (char c : {' ','o'}) _langv->push_back(c);
+    for (unsigned int c : {0x000000, 0x1e9e1e}) _palette->push_back(c);
+}
 
-    /* Colors */
-    init_pair(0,COLOR_BLACK,COLOR_BLACK);
-    init_pair(1,COLOR_GREEN,COLOR_BLACK);
+
+/**
+ * Builds the lookup table of Conway's Game of Life from the rule variables (kernel: table)
+ */
+void Simulator::build_life_table() {
+    int a = (int) get<0>(_ctrlv->at(0)), b = (int) get<0>(_ctrlv->at(1)), c = (int) get<0>(_ctrlv->at(2));
+
+    /* Next generation of the inner 2 x 2 cells of every 4 x 4 neighborhood. Bit 4 * j + i
+     * of the index is the cell in row 3 - i, column 3 - j; bits 0 to 3 of the entry are
+     * the cells (1, 1), (1, 2), (2, 1) and (2, 2). */
+    _table = new vector<unsigned char>(1 << 16);
+    for (int k = 0; k < 1 << 16; k++) {
+        int next = 0;
+        for (int q = 0; q < 4; q++) {
+            int y = 1 + q / 2, x = 1 + q % 2, pop = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (dy != 0 || dx != 0) pop += (k >> (4 * (3 - x - dx) + 3 - y - dy)) & 1;
+                }
+            }
+            int alive = (k >> (4 * (3 - x) + 3 - y)) & 1;
+            if (alive ? (pop >= a && pop <= b) : pop == c) next |= 1 << q;
+        }
+        _table->at((unsigned long) k) = (unsigned char) next;
+    }
 }
 
 
 /**
- * Coin toss using a random-device-seeded mersenne twister over a
+ * Lookup table of Conway's Game of Life (see build_life_table)
+ * @return next 2 x 2 cells of every 4 x 4 neighborhood
+ */
+const unsigned char* Simulator::life_table() {
+    return _table->data();
+}
+
+
+/**
+ * Larger than Life: a totalistic rule over the (2r+1) x (2r+1) square around a cell,
+ * the cell itself not counted
+ * @param r radius
+ * @param b1 fewest live neighbors for a birth
+ * @param b2 most live neighbors for a birth
+ * @param s1 fewest live neighbors for survival
+ * @param s2 most live neighbors for survival
+ */
+void Simulator::set_ltl(int r, int b1, int b2, int s1, int s2) {
+
+    reset();
+    _name = "Larger than Life";
+    _mode = 3;
+
+    /* Simulation vars */
+    var radius (r, "Radius");
+    var bmin (b1, "Birth Min");
+    var bmax (b2, "Birth Max");
+    var smin (s1, "Survival Min");
+    var smax (s2, "Survival Max");
+    for (var v : {radius, bmin, bmax, smin, smax}) _ctrlv->push_back(v);
+
+    /* Language */
+    for (char c : {' ','o'}) _langv->push_back(c);
+    for (unsigned int c : {0x000000, 0x1e9e1e}) _palette->push_back(c);
+}
+
+
+/**
+ * Coin toss using the simulation's mersenne twister over a
  * distribution between 1 and 100,000. After playing with some RNGs,
  * I liked this one the most. This function returns a boolean with
  * a p probability of returning true.
  * @param p probability of occurrence
  * @return bool
  */
-bool toss(double p) {
+bool Simulator::toss(double p) {
     dist d(1,100000);
-    double r = (d((gen)) / 100000.0);
+    double r = (d((_rng)) / 100000.0);
     //cout << r << " < " << p << " " << (r < p) << endl;
     return r < p;
 }
@@ -89,28 +232,111 @@ bool toss(double p) {
  * @param high range max
  * @return int
  */
-int toss(int low, int high) {
+int Simulator::toss(int low, int high) {
     dist d(low,high);
-    return (d((gen)));
+    return (d((_rng)));
 }
 
 
-void Simulator::run(Node* n) {
-    if (_mode == 1) forest_fire(n);
+/**
+ * Counter-based draw in [0,1). The result depends only on the key, so every rank or
+ * tile that evaluates the same cell in the same generation draws the same number,
+ * regardless of the order in which cells are visited.
+ * @param seed run (or stream) seed
+ * @param gen generation
+ * @param row global row
+ * @param col column (or chunk)
+ * @param k draw index
+ * @return double
+ */
+double toss_at(unsigned long seed, long gen, long row, long col, long k) {
+    unsigned long long z = seed;
+    for (long key : {gen, row, col, k}) {
+        z += 0x9e3779b97f4a7c15ULL + (unsigned long long) key;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+    }
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+void Simulator::run(Node* n, int col) {
+    if (_mode == 1) forest_fire(n, col);
     else if(_mode == 2) conway(n);
 }
 
 
+/**
+ * Position the event samplers at the start of a row
+ * @param gen generation
+ * @param row global row
+ * @param width row width
+ */
+void Simulator::seek(long gen, long row, int width) {
+    _gen = gen;
+    _row = row;
+    if (_lightning) _lightning->seek(gen, row, 0, width);
+    if (_growth) _growth->seek(gen, row, 0, width);
+}
+
+
+/**
+ * Lightning strike on a column of the current row. Columns must be queried in
+ * increasing order; only the gaps between strikes are drawn. With an ignition raster,
+ * strikes come at the map's highest probability and are kept at the cell's.
+ * @param col column
+ * @return bool
+ */
+bool Simulator::strike(int col) {
+    if (!_lightning->hit(col)) return false;
+    if (_ignition_map == nullptr) return true;
+    return toss_at(stream_seed(_seed, STREAM_STRIKE), _gen, _row, col) * _lightning->p() < _ignition_map->at(_row, col);
+}
+
+
+/**
+ * Regrowth on an empty column of the current row with probability g*(trees+1).
+ * Candidates arrive at the highest rate, 9g, and are accepted with probability
+ * g*(trees+1) / 9g, which keeps the per-cell probability exact. With a growth raster,
+ * g is the cell's and the rate the map's highest.
+ * @param col column
+ * @param trees neighboring trees
+ * @return bool
+ */
+bool Simulator::sprout(int col, int trees) {
+    if (!_growth->hit(col)) return false;
+    double g = (_growth_map == nullptr) ? get<0>(_ctrlv->at(1)) : _growth_map->at(_row, col);
+    double p = min(1.0, g * (trees + 1));
+    return toss_at(stream_seed(_seed, STREAM_ACCEPT), _gen, _row, col) * _growth->p() < p;
+}
+
+
 vector<tuple<double,string>>* Simulator::get_ctrlv() {
     return _ctrlv;
 }
 
 
+int Simulator::mode() {
+    return _mode;
+}
+
+
 char Simulator::translate(int i) {
     return _langv->at(i);
 }
 
 
+/**
+ * Color of a state in exported frames (the curses colors as RGB)
+ * @param i state
+ * @return 0xRRGGBB
+ */
+unsigned int Simulator::color(int i) {
+    return _palette->at((unsigned long) i);
+}
+
+
 int get_density(Node* n) {
     int d = 0;
     for(int x : *n->n()){ if(x == 1) d++;}
@@ -118,11 +344,7 @@ int get_density(Node* n) {
 }
 
 
-void forest_fire(Node* n) {
-    Simulator* s = Simulator::instance();
-    double i = get<0>(s->get_ctrlv()->at(0));
-    double g = get<0>(s->get_ctrlv()->at(1));
-
+void Simulator::forest_fire(Node* n, int col) {
     bool ignited = false;
     if (n->status() == 1) {
         for (int x : *n->n()) {
@@ -135,20 +357,19 @@ void forest_fire(Node* n) {
     if (!ignited) {
         if (n->status() == 2) { n->set(0, 1); }
         else if (n->status() == 1) {
-            if (toss(i)) { n->set(2, 2);}
+            if (strike(col)) { n->set(2, 2);}
         }
         else if (n->status() == 0) {
-            if (toss(g*(get_density(n)+1))) { n->set(1, 1);}
+            if (sprout(col, get_density(n))) { n->set(1, 1);}
         }
     }
 }
 
 
-void conway(Node* n) {
-    Simulator* s = Simulator::instance();
-    double u = get<0>(s->get_ctrlv()->at(0));
-    double o = get<0>(s->get_ctrlv()->at(1));
-    double g = get<0>(s->get_ctrlv()->at(2));
+void Simulator::conway(Node* n) {
+    double u = get<0>(_ctrlv->at(0));
+    double o = get<0>(_ctrlv->at(1));
+    double g = get<0>(_ctrlv->at(2));
 
     int pop = get_density(n);
 
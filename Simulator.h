@@ -1,35 +1,68 @@
 #include <vector>
 #include "Node.h"
 #include "defs.h"
+#include "Sampler.h"
+#include "Raster.h"
 #include <random>
 
 #ifndef FOREST_SIMULATOR_H
 #define FOREST_SIMULATOR_H
 
 
+/**
+ * Rules of one simulation: its mode and rule variables, state names and colors, event
+ * samplers and map RNG. Every State owns its own, so simulations in one process, on one
+ * thread or several, share nothing.
+ */
 class Simulator {
     int _mode;
     char** _argv;
     ctrlv* _ctrlv;
     langv* _langv;
+    std::vector<unsigned int>* _palette;  /* 0xRRGGBB of each state (frame export) */
     std::string _name;
+    unsigned long _seed;    /* run seed */
+    Sampler* _lightning;    /* lightning strikes (forest fire) */
+    Sampler* _growth;       /* regrowth candidates (forest fire) */
+    const Raster* _ignition_map;  /* ignition probability per cell (nullptr: uniform) */
+    const Raster* _growth_map;    /* growth probability per cell (nullptr: uniform) */
+    long _gen;              /* generation being sampled */
+    long _row;              /* global row being sampled */
+    std::vector<unsigned char>* _table;  /* next 2 x 2 cells of every 4 x 4 neighborhood (Conway) */
+    std::mt19937 _rng;      /* map generation RNG */
     // std::vector<std::vector<int>>* _memv;    // For when I decide to implement memory
     Simulator(Simulator const& copy);            // Not Implemented
     Simulator* operator=(Simulator const* copy);
-    Simulator();
+    void forest_fire(Node* n, int col);
+    void conway(Node* n);
 public:
-    static Simulator* instance() {
-        static Simulator instance;
-        return &instance;
-    }
-    void run(Node* node);
+    Simulator();
+    ~Simulator();
+    void run(Node* node, int col);
+    void set_seed(unsigned long s);
+    bool toss(double p);
+    int toss(int low, int high);
+    void seek(long gen, long row, int width);
+    bool strike(int col);
+    bool sprout(int col, int trees);
     void init(char** argv);
+    void reset();
     void set_forest(double i, double g);
+    void set_terrain(const Raster* ignition, double i, const Raster* growth, double g);
+    const Raster* ignition_map();
+    const Raster* growth_map();
+    double lightning_rate();
+    double growth_rate();
     //void set_mode(int mode);
     ctrlv* get_ctrlv();
+    int mode();
     void display();
     char translate(int i);
+    unsigned int color(int i);
     void set_conway(int a, int b, int c);
+    void build_life_table();
+    const unsigned char* life_table();
+    void set_ltl(int r, int b1, int b2, int s1, int s2);
     friend std::ostream& operator<<(std::ostream&, const Simulator&);
     friend std::string& operator += (std::string&, const Simulator&);
 };
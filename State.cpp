@@ -7,46 +7,263 @@
 #include "State.h"
 #include "Simulator.h"
 #include "defs.h"
-#include <ncurses.h>
+#include "Wire.h"
+#include "Sampler.h"
+#include <stdexcept>
 
 using namespace std;
-extern string print_row(int thread, int row, int width, vector<Node*>* nodev);
 
 /**
- * Default constructor
+ * Deletes an object and forgets it, so that releasing twice is harmless
+ * @param p object, set to nullptr
+ */
+template <class T> static void drop(T*& p) {
+    delete p;
+    p = nullptr;
+}
+
+
+/**
+ * Command-line constructor (forest binary). MPI must be initialized.
  * @param argc argc
  * @param argv argv
+ * @param comm ranks sharing the simulation
+ * @param screen screen master draws on
  * @return State object
  */
-State::State(int argc, char **argv) {
+State::State(int argc, char **argv, MPI_Comm comm, Screen* screen) {
     //check(argc, argv);
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &_size);
-
+    init_state(comm, screen);
     _filename = argv[1];
     _mode = (argc == 5) ? 1 : 2;
-    if (_mode == 2) {
-        _current = 1;
-        init_sim(_filename);
+    try {
+        if (_mode == 2) {
+            _current = 1;
+            fstream file;
+            file.open (_filename, fstream::in);
+            if (!file) fail(ERROR_FILE);
+            init_sim(file);
+        }
+        else {
+            _generations = stoi(argv[2]);
+            _current = 1;
+            _ignition = stod(argv[3]);
+            _growth = stod(argv[4]);
+            get_map();
+        }
+    } catch (...) {
+        release();
+        free_grid();
+        throw;
     }
-    else {
-        _generations = stoi(argv[2]);
-        _current = 1;
-        _ignition = stod(argv[3]);
-        _growth = stod(argv[4]);
-        get_map();
+}
+
+
+/**
+ * Constructor from the text of a .sim file (embedded use, by default without a screen).
+ * A rejected simulation releases whatever it had built before the error is thrown.
+ * MPI must be initialized.
+ * @param sim .sim text
+ * @param comm ranks sharing the simulation
+ * @param screen screen master draws on
+ * @param spare finished simulation whose strip may be taken over (see take_grid)
+ * @return State object
+ */
+State::State(istream& sim, MPI_Comm comm, Screen* screen, State* spare) {
+    init_state(comm, screen);
+    _mode = 2;
+    _current = 1;
+    _spare = spare;
+    try {
+        init_sim(sim);
+    } catch (...) {
+        release();
+        free_grid();
+        throw;
+    }
+    _spare = nullptr;
+}
+
+
+/**
+ * Destructor. Collective over the simulation's communicator when the strip is in a
+ * shared or RMA window.
+ */
+State::~State() {
+    release();
+    free_grid();
+}
+
+
+/**
+ * Frees everything but the strip and its windows, and closes the query socket. The
+ * strip stays for free_grid(), or for a later simulation to take over.
+ */
+void State::release() {
+    _spare = nullptr;
+    if (_nodes != nullptr) for (Row* r : *_nodes) delete r;
+    drop(_outer_top);
+    drop(_outer_bot);
+    drop(_recv_row);
+    drop(_nodes);
+    drop(_node_map);
+    drop(_map);
+    drop(_sim);
+    drop(_ignition_map);
+    drop(_growth_map);
+    drop(_world);
+    drop(_edges);
+    drop(_border_out);
+    drop(_border_in);
+    drop(_patch_out);
+    drop(_patch_in);
+    drop(_a2a);
+    for (vector<int>** v : {&_frontier, &_ignite, &_grow, &_delta_top, &_delta_bot, &_remote_top, &_remote_bot, &_delta_recv}) drop(*v);
+    drop(_active);
+    drop(_flips);
+    drop(_counts);
+    drop(_marked);
+    for (vector<unsigned char>** v : {&_wire_top, &_wire_bot, &_wire_recv, &_strip}) drop(*v);
+    drop(_frame_raw);
+    drop(_frame);
+    drop(_frame_sums);
+    drop(_cluster_out);
+    drop(_mask);
+    drop(_scar);
+    drop(_uf_parent);
+    for (vector<long>** v : {&_uf_size, &_block, &_block_in, &_block_out}) drop(*v);
+    drop(_query_out);
+    drop(_query_counts);
+    drop(_query_sum);
+    drop(_query_requests);
+    if (_query_shape[0] > 0) MPI_Type_free(&_query_type);
+    _query_shape[0] = 0;
+    if (_query_conn >= 0) close(_query_conn);
+    _query_conn = -1;
+    if (_query_listen >= 0) {
+        close(_query_listen);
+        unlink(_query_path.c_str());
     }
+    _query_listen = -1;
+    drop(_hashes);
+    drop(_hash_gens);
+    for (vector<int>** v : {&_view_col, &_view_counts, &_view_all, &_view_sum, &_view_sizes, &_view_displs}) drop(*v);
 }
 
 
 /**
- * Initialize simulator from file
+ * Settings before the simulation is read
+ * @param comm ranks sharing the simulation
+ * @param screen screen master draws on (nullptr for none)
  */
-void State::init_sim(string filename) {
+void State::init_state(MPI_Comm comm, Screen* screen) {
+    _comm = comm;
+    _screen = screen;
+    MPI_Comm_rank(_comm, &_rank);
+    MPI_Comm_size(_comm, &_size);
+
+    _sim = new Simulator();
+    _spare = nullptr;
+    _ignition_map = _growth_map = nullptr;
+    _engine = ENGINE_NODE;
+    _tile = DEFAULT_TILE;
+    _depth = DEFAULT_DEPTH;
+    _step = 1;
+    _radius = 1;
+    _sums = nullptr;
+    _seeded = false;
+    _seed = 0;
+    _grid = nullptr;
+    _scratch = nullptr;
+    _frontier = nullptr;
+    _ignite = _grow = _delta_top = _delta_bot = nullptr;
+    _remote_top = _remote_bot = _delta_recv = nullptr;
+    _counts = _marked = nullptr;
+    _active = _flips = nullptr;
+    _judged = 0;
+    _flipped = 0;
+    _world = nullptr;
+    _edges = nullptr;
+    _border_out = _border_in = nullptr;
+    _patch_out = _patch_in = nullptr;
+    _a2a = nullptr;
+    _wire_top = _wire_bot = _wire_recv = _strip = nullptr;
+    _view_col = _view_counts = _view_all = _view_sum = _view_sizes = _view_displs = nullptr;
+    _nodes = _node_map = nullptr;
+    _map = nullptr;
+    _halo = HALO_SHM;
+    _kernel = KERNEL_DIRECT;
+    _tune = false;
+    _tune_file = "forest.tune";
+    _tuned = TUNE_NONE;
+    _tune_trials = 0;
+    _tune_time = 0;
+    _shm_top = false;
+    _shm_bot = false;
+    _rma = false;
+    _halo_time = 0;
+    _halo_max = 0;
+    _halo_count = 0;
+    _wire_sent = 0;
+    _wire_raw = 0;
+    _display = screen != nullptr;
+    _view = VIEW_AUTO;
+    _reduce = REDUCE_MAJORITY;
+    _viewport = false;
+    _view_h = 0;
+    _view_w = 0;
+    _outer_top = nullptr;
+    _outer_bot = nullptr;
+    _recv_row = nullptr;
+    _alloc_mark = 0;
+    _alloc_end = 0;
+    _rss_mark = 0;
+    _rss_end = 0;
+    _time_start = 0;
+    _time_end = 0;
+    _frames = 0;
+    _frame_format = FRAME_PPM;
+    _frame_scale = 1;
+    _frame_file = "frame";
+    _frame_row = 0;
+    _frame_raw = _frame = nullptr;
+    _frame_sums = nullptr;
+    _frame_count = 0;
+    _frame_bytes = 0;
+    _frame_time = 0;
+    _clusters = 0;
+    _cluster_file = "clusters.txt";
+    _cluster_out = nullptr;
+    _mask = _scar = nullptr;
+    _uf_parent = nullptr;
+    _uf_size = _block = _block_in = _block_out = nullptr;
+    _census_count = 0;
+    _census_time = 0;
+    _query_listen = -1;
+    _query_conn = -1;
+    for (int& v : _query) v = 0;
+    _query_out = nullptr;
+    _query_counts = _query_sum = nullptr;
+    _query_requests = nullptr;
+    for (int& v : _query_shape) v = 0;
+    _query_count = 0;
+    _steady = STEADY_OFF;
+    _history = DEFAULT_HISTORY;
+    _hashes = nullptr;
+    _hash_gens = nullptr;
+    _hash_count = 0;
+    _period = 0;
+    _onset = 0;
+    _skipped = 0;
+}
+
+
+/**
+ * Initialize simulator from the text of a .sim file
+ * @param file .sim text
+ */
+void State::init_sim(istream& file) {
     int mode;
-    fstream file;
-    file.open (filename, fstream::in);
     string line;
 
     /* Mode */
@@ -88,8 +305,12 @@ void State::init_sim(string filename) {
         getline(file, line);
         density = stod(line);
 
+        read_options(file);
+        init_seed();
         init_window();
-        Simulator::instance()->set_forest(i,g);
+        _sim->set_forest(i,g);
+        set_bounds();
+        init_wire(mode);
         generate_nodes(0,1,density);
     }
 
@@ -118,52 +339,267 @@ void State::init_sim(string filename) {
         getline(file, line);
         density = stod(line);
 
+        read_options(file);
+        init_seed();
         init_window();
-        Simulator::instance()->set_conway(u,o,g);
+        _sim->set_conway(u,o,g);
+        set_bounds();
+        init_wire(mode);
         generate_nodes(0,1,density);
     }
 
-    set_bounds();
+    /* Larger than Life (Mode 3) */
+    if (mode == 3) {
+        int r, b1, b2, s1, s2;
+        double density;
+
+        /* Radius */
+        getline(file, line);
+        getline(file, line);
+        r = stoi(line);
+        if (r < 1) fail(ERROR_RADIUS);
+
+        /* Birth range */
+        getline(file, line);
+        getline(file, line);
+        b1 = stoi(line);
+        getline(file, line);
+        getline(file, line);
+        b2 = stoi(line);
+
+        /* Survival range */
+        getline(file, line);
+        getline(file, line);
+        s1 = stoi(line);
+        getline(file, line);
+        getline(file, line);
+        s2 = stoi(line);
+
+        /* Initial Density */
+        getline(file, line);
+        getline(file, line);
+        density = stod(line);
+
+        read_options(file);
+        if (_engine == ENGINE_NODE) _engine = ENGINE_BLOCKED;   /* nodes hold 8 neighbors */
+        if (_engine != ENGINE_BLOCKED) fail(ERROR_ENGINE);
+        _radius = r;
+        init_seed();
+        init_window();
+        _sim->set_ltl(r,b1,b2,s1,s2);
+        set_bounds();
+        init_wire(mode);
+        generate_nodes(0,1,density);
+    }
+
+    if (_kernel == KERNEL_TABLE && (_engine != ENGINE_BLOCKED || _sim->mode() != 2)) fail(ERROR_KERNEL);
+    if (_kernel == KERNEL_TABLE) _sim->build_life_table();
     build_nodes();
+    if (_engine == ENGINE_BLOCKED) {
+        if (_tune) tune();
+        build_grid();
+    }
+    if (_engine == ENGINE_FRONTIER) build_frontier();
+    if (_engine == ENGINE_SPARSE) build_sparse();
+    if (_engine == ENGINE_DELTA) build_delta();
+    init_terrain();
+    init_viewport();
+    init_frames();
+    init_clusters();
+    init_query();
+    init_steady();
+    _time_start = MPI_Wtime();
+
+}
+
+
+/**
+ * Reads optional settings that follow the simulation variables in a .sim file.
+ * Each setting is a "name:" line followed by a value line, like the rest of the file.
+ * @param file .sim file positioned after the last simulation variable
+ */
+void State::read_options(istream& file) {
+    string key, value;
+    while (getline(file, key)) {
+        if (key.find_first_not_of(" \t\r") == string::npos) continue;
+        getline(file, value);
+        key = key.substr(0, key.find(':'));
+        value = value.substr(0, value.find_last_not_of(" \t\r") + 1);
+        set_option(key, value);
+    }
+}
+
+
+/**
+ * Applies a single optional setting
+ * @param key setting name
+ * @param value setting value
+ */
+void State::set_option(string key, string value) {
+    if (key == "engine") {
+        if (value == "node") _engine = ENGINE_NODE;
+        else if (value == "blocked") _engine = ENGINE_BLOCKED;
+        else if (value == "frontier") _engine = ENGINE_FRONTIER;
+        else if (value == "sparse") _engine = ENGINE_SPARSE;
+        else if (value == "delta") _engine = ENGINE_DELTA;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "tile") _tile = max(1, stoi(value));
+    else if (key == "depth") _depth = max(1, stoi(value));
+    else if (key == "seed") { _seed = stoul(value); _seeded = true; }
+    else if (key == "display") _display = stoi(value) != 0 && _screen != nullptr;
+    else if (key == "halo") {
+        if (value == "p2p") _halo = HALO_P2P;
+        else if (value == "shm") _halo = HALO_SHM;
+        else if (value == "rma") _halo = HALO_RMA;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "kernel") {
+        if (value == "direct") _kernel = KERNEL_DIRECT;
+        else if (value == "table") _kernel = KERNEL_TABLE;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "tune") {
+        if (value == "on") _tune = true;
+        else if (value == "off") _tune = false;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "tune file") _tune_file = value;
+    else if (key == "viewport") {
+        if (value == "auto") _view = VIEW_AUTO;
+        else if (value == "on") _view = VIEW_ON;
+        else if (value == "off") _view = VIEW_OFF;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "frames") _frames = max(0, stoi(value));
+    else if (key == "frame file") _frame_file = value;
+    else if (key == "frame scale") _frame_scale = max(1, stoi(value));
+    else if (key == "frame format") {
+        if (value == "ppm") _frame_format = FRAME_PPM;
+        else if (value == "pgm") _frame_format = FRAME_PGM;
+        else if (value == "png") _frame_format = FRAME_PNG;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "steady") {
+        if (value == "off") _steady = STEADY_OFF;
+        else if (value == "stop") _steady = STEADY_STOP;
+        else if (value == "skip") _steady = STEADY_SKIP;
+        else fail(ERROR_OPTION);
+    }
+    else if (key == "clusters") _clusters = max(0, stoi(value));
+    else if (key == "cluster file") _cluster_file = value;
+    else if (key == "query") _query_path = value;
+    else if (key == "ignition map") _ignition_file = value;
+    else if (key == "growth map") _growth_file = value;
+    else if (key == "history") _history = max(1, stoi(value));
+    else if (key == "reduce") {
+        if (value == "majority") _reduce = REDUCE_MAJORITY;
+        else if (value == "any") _reduce = REDUCE_ANY;
+        else fail(ERROR_OPTION);
+    }
+    else fail(ERROR_OPTION);
+}
 
+
+/**
+ * Agree on a run seed. Without a seed in the .sim file, master draws one and
+ * broadcasts it so that every rank keys the grid engines' draws identically.
+ */
+void State::init_seed() {
+    if (!_seeded) {
+        random_device rd;
+        _seed = (_rank == 0) ? rd() : 0;
+    }
+    MPI_Bcast(&_seed, 1, MPI_UNSIGNED_LONG, 0, _comm);
+    _sim->set_seed(_seed);
+}
+
+
+/**
+ * Maps the forest's probability rasters, the rows of the local strip and, for the
+ * blocked engine, the halo rows a block also steps. The event rates become the highest
+ * probabilities of the whole map, so that every rank draws the same events.
+ */
+void State::init_terrain() {
+    if (_ignition_file.empty() && _growth_file.empty()) return;
+    Simulator* sim = _sim;
+    if (sim->mode() != 1) fail(ERROR_TERRAIN);
+    int halo = (_engine == ENGINE_BLOCKED) ? _depth * _radius : 0;
+    long first = (_start < 0) ? 0 : max(0, _start - halo);
+    long last = (_start < 0) ? 0 : min(_height, _end + halo);
+    double p[2] = {get<0>(sim->get_ctrlv()->at(0)), get<0>(sim->get_ctrlv()->at(1))};
+    double top[2];
+    if (!_ignition_file.empty()) _ignition_map = new Raster(_ignition_file, _height, _width, first, (int) (last - first), p[0]);
+    if (!_growth_file.empty()) _growth_map = new Raster(_growth_file, _height, _width, first, (int) (last - first), p[1]);
+    if (_ignition_map != nullptr) p[0] = (_start < 0) ? 0 : _ignition_map->max(_start, _end);
+    if (_growth_map != nullptr) p[1] = (_start < 0) ? 0 : _growth_map->max(_start, _end);
+    MPI_Allreduce(p, top, 2, MPI_DOUBLE, MPI_MAX, _comm);
+    sim->set_terrain(_ignition_map, top[0], _growth_map, top[1]);
 }
 
 
 /**
- * Generates a node state map from passed arguments
+ * Generates a node state map from passed arguments. Every rank draws only its own strip,
+ * keyed on each cell's global position, so the map is the same at any number of ranks.
  */
 void State::generate_nodes(int min, int max, double density) {
     _node_map = new vector<Row*>();
-    if (_rank == 0) {
-        int send[_height][_width];
-        for (int i = 0; i < _height; i++) {
-            int nodes[_width];
-            for (int j = 0; j < _width; j++) {
-                int status = toss(density);
-                nodes[j] = status;
-                send[i][j] = status;
-            }
-            _node_map->push_back(new Row(nodes,_width));
-        }
-        for (int i = 1; i < _size; i++) {
-            MPI_Send(&send,_width*_height,MPI_INT,i,0,MPI_COMM_WORLD);
-        }
-    }
-    else {
-        MPI_Status status;
-        int recv[_height][_width];
-        MPI_Recv(&recv,_width*_height,MPI_INT,0,0,MPI_COMM_WORLD,&status);
-        for (int i = 0; i < _height; i++) {
-            int nodes[_width];
-            for (int j = 0; j < _width; j++) {
-                nodes[j] = recv[i][j];
-            }
-            _node_map->push_back(new Row(nodes,_width));
-        }
+    unsigned long key = stream_seed(_seed, STREAM_MAP);
+    vector<int> nodes((unsigned long) _width);
+    for (int i = _start; i < _end; i++) {
+        for (int j = 0; j < _width; j++) nodes[j] = toss_at(key, 0, i, j) < density;
+        _node_map->push_back(new Row(nodes.data(),_width));
     }
 }
 
 
+/**
+ * Sizes the wire buffers for the largest strip
+ * @param mode simulation mode
+ */
+void State::init_wire(int mode) {
+    _bits = wire_bits(mode);
+    int strip = _height / min(_size, _height) + 1;
+    unsigned long bytes = (unsigned long) wire_max(strip * _width);
+    _wire_top = new vector<unsigned char>(bytes);
+    _wire_bot = new vector<unsigned char>(bytes);
+    _wire_recv = new vector<unsigned char>(bytes);
+    _strip = new vector<unsigned char>((unsigned long) strip * _width);
+}
+
+
+/**
+ * Packs a block of cells into a wire buffer
+ * @param cells first cell
+ * @param rows rows in the block
+ * @param stride distance between rows in cells
+ * @param buf wire buffer
+ * @return bytes to send
+ */
+int State::pack_cells(const unsigned char* cells, int rows, int stride, vector<unsigned char>* buf) {
+    int bytes = wire_pack(cells, rows, _width, stride, _bits, buf->data());
+    _wire_sent += (unsigned long) bytes;
+    _wire_raw += (unsigned long) rows * _width * sizeof(int);
+    return bytes;
+}
+
+
+/**
+ * Receives and unpacks a block of cells. Blocks on receive.
+ * @param cells first cell to write
+ * @param rows rows in the block
+ * @param stride distance between rows in cells
+ * @param source sending rank
+ */
+void State::recv_cells(unsigned char* cells, int rows, int stride, int source) {
+    MPI_Status status;
+    int bytes;
+    MPI_Recv(_wire_recv->data(),(int) _wire_recv->size(),MPI_UNSIGNED_CHAR,source,0,_comm,&status);
+    MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &bytes);
+    wire_unpack(_wire_recv->data(), bytes, rows, _width, stride, _bits, cells);
+}
+
+
 /**
  * Reads and converts a map from file
  */
@@ -184,10 +620,18 @@ void State::get_map() {
     _height = (int) _map->size();
     _width = (int) _map->front().length();
 
+    init_seed();
     set_bounds();
+    init_wire(1);
     build_nodes();
     init_window();
-    Simulator::instance()->set_forest(_ignition,_growth);
+    init_viewport();
+    _sim->set_forest(_ignition,_growth);
+    init_frames();
+    init_clusters();
+    init_query();
+    init_steady();
+    _time_start = MPI_Wtime();
 
 }
 
@@ -239,7 +683,8 @@ void State::set_bounds() {
 
 /**
  * Builds node structure from map file for data inside boundaries.
- * Sets pointers to the top and bottom rows for transmission.
+ * Sets pointers to the top and bottom rows for transmission, and allocates
+ * the remote and display rows that every generation reuses.
  */
 void State::build_nodes() {
     _nodes = new vector<Row *>();
@@ -248,33 +693,58 @@ void State::build_nodes() {
     }
     else {
         for (int i = _start; i < _end; i++) {
-            _nodes->push_back(_node_map->at(i));
+            _nodes->push_back(_node_map->at((unsigned long) (i - _start)));
         }
     }
 
     _inner_top = _nodes->front();
     _inner_bot = _nodes->back();
+
+    vector<int> empty((unsigned long) _width, 0);
+    if (_top > -1) _outer_top = new Row(empty.data(),_width);
+    if (_bot > -1) _outer_bot = new Row(empty.data(),_width);
+    if (_rank == 0) _recv_row = new Row(empty.data(),_width);
 }
 
 
 /**
- * Send / receive border rows between threads. Blocks on receive, but not on send.
+ * Exchange border rows with the neighboring threads, using the engine's halo exchange,
+ * and time it for the run summary
  */
 void State::transmit_nodes() {
-    int send_top[_width], send_bot[_width], recv_top[_width], recv_bot[_width];
-
-    MPI_Request request;
-    if (_top > -1) for (int j = 0; j < _width; j++) send_top[j] = _inner_top->get(j);
-    if (_bot > -1) for (int j = 0; j < _width; j++) send_bot[j] = _inner_bot->get(j);
-    if (_top > -1) MPI_Isend(&send_top,_width,MPI_INT,_top,0,MPI_COMM_WORLD,&request);
-    if (_bot > -1) MPI_Isend(&send_bot,_width,MPI_INT,_bot,0,MPI_COMM_WORLD,&request);
+    double t = MPI_Wtime();
+    if (_engine == ENGINE_BLOCKED) transmit_grid();
+    else if (_engine == ENGINE_FRONTIER || _engine == ENGINE_DELTA) transmit_frontier();
+    else if (_engine == ENGINE_SPARSE) transmit_sparse();
+    else transmit_rows();
+    t = MPI_Wtime() - t;
+    _halo_time += t;
+    _halo_max = max(_halo_max, t);
+    _halo_count++;
+}
 
-    MPI_Status status;
-    if (_top > -1) MPI_Recv(&recv_top,_width,MPI_INT,_top,0,MPI_COMM_WORLD,&status);
-    if (_bot > -1) MPI_Recv(&recv_bot,_width,MPI_INT,_bot,0,MPI_COMM_WORLD,&status);
 
-    if (_top > -1) _outer_top = new Row(recv_top,_width);
-    if (_bot > -1) _outer_bot = new Row(recv_bot,_width);
+/**
+ * Send / receive border rows between threads in the packed wire format. Blocks on
+ * receive; sends complete before returning. Received rows overwrite the remote rows
+ * in place.
+ */
+void State::transmit_rows() {
+    unsigned char send_top[_width], send_bot[_width], recv_top[_width], recv_bot[_width];
+
+    MPI_Request requests[2];
+    int n = 0;
+    if (_top > -1) for (int j = 0; j < _width; j++) send_top[j] = (unsigned char) _inner_top->get(j);
+    if (_bot > -1) for (int j = 0; j < _width; j++) send_bot[j] = (unsigned char) _inner_bot->get(j);
+    if (_top > -1) MPI_Isend(_wire_top->data(),pack_cells(send_top,1,_width,_wire_top),MPI_UNSIGNED_CHAR,_top,0,_comm,&requests[n++]);
+    if (_bot > -1) MPI_Isend(_wire_bot->data(),pack_cells(send_bot,1,_width,_wire_bot),MPI_UNSIGNED_CHAR,_bot,0,_comm,&requests[n++]);
+
+    if (_top > -1) recv_cells(recv_top, 1, _width, _top);
+    if (_bot > -1) recv_cells(recv_bot, 1, _width, _bot);
+    MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+
+    if (_top > -1) _outer_top->set(recv_top);
+    if (_bot > -1) _outer_bot->set(recv_bot);
 }
 
 
@@ -284,6 +754,7 @@ void State::transmit_nodes() {
  * is out of bounds, it is marked with a 3.
  */
 void State::update_neighbors() {
+    if (_engine != ENGINE_NODE) return;   /* neighbors are read straight from the grid */
     for (int i = 0; i < _nodes->size(); i++) {
         Row* r = _nodes->at(i);
         for (int j = 0; j < _width; j++) {
@@ -319,13 +790,25 @@ void State::update_neighbors() {
 
 
 /**
- * Applies the rules of the simulation for each generation on each node. I added a few
- * adjustable parameters to get more exciting simulations going.
- * @param burn The probability that a burning tree ignites an adjacent tree
- * @param grow A constant that allows an empty cell to produce a tree
+ * Applies the rules of the simulation for each generation on each node. The
+ * simulator's event samplers are positioned at the start of every row, so each
+ * node can ask for its lightning / regrowth outcome by column. Then looks for a
+ * steady state.
  */
 void State::apply_simulation() {
-    for (Row* r : *_nodes) { for (int j = 0; j < _width; j++) { Simulator::instance()->run(r->get_node(j)); }}
+    if (_engine == ENGINE_BLOCKED) step_blocked();
+    else if (_engine == ENGINE_FRONTIER) step_frontier();
+    else if (_engine == ENGINE_SPARSE) step_sparse();
+    else if (_engine == ENGINE_DELTA) step_delta();
+    else {
+        Simulator* sim = _sim;
+        for (int i = 0; i < _nodes->size(); i++) {
+            Row* r = _nodes->at((unsigned long) i);
+            sim->seek(_current, _start + i, _width);
+            for (int j = 0; j < _width; j++) { sim->run(r->get_node(j), j); }
+        }
+    }
+    if (_steady != STEADY_OFF) check_steady();
 }
 
 
@@ -337,6 +820,14 @@ int State::get_current_generation() {
 }
 
 
+/**
+ * @return next generation to step
+ */
+int State::get_generation() {
+    return _current;
+}
+
+
 /**
  * @param i row number
  * @return Row* object
@@ -362,24 +853,61 @@ int State::get_node_color(int r, int n) {
 
 
 /**
- * Increments the current generation (used in main)
+ * Advances the current generation past the last step (used in main), exporting a frame
+ * when the step reached a multiple of `frames` and counting clusters when it reached a
+ * multiple of `clusters`. The first and last steps bound the steady state reported in
+ * the run summary.
  */
 void State::inc_n() {
-    _current++;
+    if (_frames > 0 && (_current + _step - 1) / _frames > (_current - 1) / _frames) export_frame();
+    if (_clusters > 0) {
+        mark_scars();
+        if ((_current + _step - 1) / _clusters > (_current - 1) / _clusters) census();
+    }
+    if (!_query_path.empty()) serve_query();
+    if (_current - _skipped == 1) {
+        _alloc_mark = alloc_count();
+        _rss_mark = rss_kb();
+    }
+    _current += _step;
+    if (!running()) {
+        _alloc_end = alloc_count();
+        _rss_end = rss_kb();
+        _time_end = MPI_Wtime();
+    }
+}
+
+
+/**
+ * Advances the simulation n generations without displaying them (embedded use)
+ * @param n generations
+ */
+void State::advance(int n) {
+    _generations = _current + n - 1;
+    while (running()) {
+        transmit_nodes();
+        update_neighbors();
+        apply_simulation();
+        inc_n();
+    }
 }
 
 
 /**
- * Exit with error message
+ * @return true while generations remain
+ */
+bool State::running() {
+    return _current <= _generations;
+}
+
+
+/**
+ * Abort the simulation with an error message. The forest binary prints it with the
+ * usage; embedding programs catch it.
  * @param e
  */
 void State::fail(string e) {
-    if (_rank == 0) {
-        cout << e << endl << "Usage:" << endl;
-        cout << "Mode 1: ./forest [filename] [# generations] [ignition probability] [growth probability]" << endl;
-        cout << "Mode 2: ./forest [.sim filename]" << endl;
-    }
-    quit();
+    throw runtime_error(e);
 }
 
 
@@ -398,10 +926,3 @@ void State::check(int argc, char** argv) {
 }
 
 
-/**
- * Finalize MPI
- */
-void quit() {
-    MPI_Finalize();
-    exit(0);
-}
\ No newline at end of file
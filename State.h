@@ -1,11 +1,23 @@
 #ifndef FOREST_STATE_H
 #define FOREST_STATE_H
 
+#include <mpi.h>
 #include <vector>
+#include <string>
+#include <fstream>
 #include "Row.h"
 #include "Node.h"
+#include "Grid.h"
+#include "Raster.h"
+#include "World.h"
+#include "Screen.h"
+#include "Simulator.h"
 
 class State {
+    MPI_Comm _comm;      /* ranks sharing the simulation */
+    Screen* _screen;     /* screen master draws on (nullptr when embedded) */
+    Simulator* _sim;     /* rules, samplers and RNG of this simulation */
+    State* _spare;       /* finished simulation whose strip may be taken over (setup only) */
     int _rank;           /* process rank */
     int _size;           /* number of processes */
 
@@ -14,6 +26,7 @@ class State {
     int _height;         /* map height */
     int _width;          /* map width */
 
+    bool _display;        /* curses display on */
     int _win_height;      /* curses window height */
     int _win_width;
 
@@ -21,6 +34,10 @@ class State {
     int _current;        /* current generation */
     double _ignition;    /* ignition probability */
     double _growth;      /* growth probability */
+    std::string _ignition_file; /* ignition probability raster (empty: uniform) */
+    std::string _growth_file;   /* growth probability raster (empty: uniform) */
+    Raster* _ignition_map;      /* ignition probabilities of the stepped rows */
+    Raster* _growth_map;        /* growth probabilities of the stepped rows */
 
     int _start;          /* start row index */
     int _end;            /* end row index */
@@ -30,38 +47,255 @@ class State {
     Row* _inner_bot;     /* bottom row (local) */
     Row* _outer_top;     /* top row (remote) */
     Row* _outer_bot;     /* bottom row (remote) */
+    Row* _recv_row;      /* row received for display (master) */
+    std::string _out;    /* text of the last displayed generation */
+
+    unsigned long _alloc_mark;  /* allocations when the steady state began */
+    unsigned long _alloc_end;   /* allocations after the last generation */
+    long _rss_mark;             /* resident KB when the steady state began */
+    long _rss_end;              /* resident KB after the last generation */
+    double _time_start;         /* MPI_Wtime when the simulation was set up */
+    double _time_end;           /* MPI_Wtime after the last generation */
+
+    int _engine;         /* stepping engine */
+    int _tile;           /* tile edge (blocked engine) */
+    int _depth;          /* generations per block (blocked engine) */
+    int _step;           /* generations advanced by the current step */
+    int _radius;         /* cells a generation reaches (Larger than Life radius, else 1) */
+    bool _seeded;        /* seed given in .sim file */
+    unsigned long _seed; /* run seed */
+    Grid* _grid;         /* flat local strip (grid engines) */
+    std::vector<unsigned char>* _scratch; /* tile buffers (blocked engine) */
+    std::vector<int>* _sums;       /* running sums of a tile (Larger than Life) */
+    std::vector<int>* _frontier;   /* burning cells (frontier engine) */
+    std::vector<int>* _ignite;     /* cells set burning this generation */
+    std::vector<int>* _grow;       /* cells regrowing this generation */
+    std::vector<int>* _delta_top;  /* changes to the top row, for the top neighbor */
+    std::vector<int>* _delta_bot;  /* changes to the bottom row, for the bottom neighbor */
+    std::vector<int>* _remote_top; /* changes to the top halo row */
+    std::vector<int>* _remote_bot; /* changes to the bottom halo row */
+    std::vector<int>* _delta_recv; /* received change list */
+    std::vector<unsigned char>* _counts; /* live neighbors of each cell (delta engine) */
+    std::vector<unsigned char>* _marked; /* cell queued to be judged */
+    std::vector<int>* _active;     /* cells to judge next generation */
+    std::vector<int>* _flips;      /* cells that change this generation */
+    unsigned long _judged;         /* cells judged */
+    unsigned long _flipped;        /* cells changed */
+    World* _world;       /* tiles owned by this rank (sparse engine) */
+    TileMap* _edges;     /* tile -> its received edges (sparse engine) */
+    std::vector<Border>* _border_out;  /* edges sent, grouped by rank */
+    std::vector<Border>* _border_in;   /* edges received */
+    std::vector<Patch>* _patch_out;    /* row words sent, grouped by rank */
+    std::vector<Patch>* _patch_in;     /* row words received */
+    std::vector<int>* _a2a;            /* all-to-all counts and offsets */
+
+    int _bits;           /* bits per cell on the wire */
+    std::vector<unsigned char>* _wire_top;  /* packed message to the top neighbor */
+    std::vector<unsigned char>* _wire_bot;  /* packed message to the bottom neighbor */
+    std::vector<unsigned char>* _wire_recv; /* packed message received */
+    std::vector<unsigned char>* _strip;     /* unpacked strip (display) */
+    unsigned long _wire_sent;  /* bytes sent in the wire format */
+    unsigned long _wire_raw;   /* bytes the same cells take as MPI_INT */
+
+    int _view;           /* viewport setting */
+    int _reduce;         /* viewport block reduction */
+    bool _viewport;      /* display downsampled to the terminal */
+    int _view_h;         /* viewport rows */
+    int _view_w;         /* viewport columns */
+    int _view_lo;        /* first viewport row of the local strip */
+    std::vector<int>* _view_col;    /* viewport column of each map column */
+    std::vector<int>* _view_counts; /* state counts per block of the local strip */
+    std::vector<int>* _view_all;    /* gathered counts of every strip (master) */
+    std::vector<int>* _view_sum;    /* state counts per block (master) */
+    std::vector<int>* _view_sizes;  /* gathered counts per rank (master) */
+    std::vector<int>* _view_displs; /* offset of each rank's counts (master) */
+
+    int _halo;           /* halo exchange backend (grid engines) */
+    int _kernel;         /* Conway tile kernel (blocked engine) */
+    bool _tune;          /* tile, depth and halo tuned at startup (blocked engine) */
+    std::string _tune_file;  /* tuning file name */
+    int _tuned;          /* where the tile, depth and halo came from */
+    int _tune_trials;    /* candidates timed */
+    double _tune_time;   /* seconds spent tuning */
+    MPI_Comm _shm_comm;  /* ranks sharing this node */
+    MPI_Win _shm_win;    /* shared window holding the node's strips */
+    bool _shm_top;       /* top neighbor's rows read in place */
+    bool _shm_bot;       /* bottom neighbor's rows read in place */
+    bool _rma;           /* halo rows put by the neighbors */
+    MPI_Win _rma_win;    /* window exposing the local strip */
+    MPI_Group _rma_group; /* neighbors that put into / expose _rma_win */
+    double _halo_time;   /* seconds spent exchanging halos */
+    double _halo_max;    /* slowest exchange (seconds) */
+    long _halo_count;    /* halo exchanges */
+
+    int _frames;         /* generations between exported frames (0: none) */
+    int _frame_format;   /* image format */
+    int _frame_scale;    /* pixels per cell edge */
+    std::string _frame_file;  /* frame file name prefix */
+    long _frame_row;     /* bytes per pixel row */
+    std::vector<unsigned char>* _frame_raw;  /* pixel rows of the local strip */
+    std::vector<unsigned char>* _frame;      /* png chunk of the local strip */
+    std::vector<unsigned long>* _frame_sums; /* Adler-32 sums of every strip (png) */
+    long _frame_count;   /* frames written */
+    unsigned long _frame_bytes; /* bytes written */
+    double _frame_time;  /* seconds spent exporting */
+
+    int _steady;         /* steady-state detection setting */
+    int _history;        /* fingerprints kept for cycle detection */
+    int _clusters;       /* generations between cluster censuses (0: none) */
+    std::string _cluster_file;  /* census file name */
+    std::ofstream* _cluster_out;   /* census file (master) */
+    std::vector<unsigned char>* _mask;  /* cells being labeled (local strip) */
+    std::vector<unsigned char>* _scar;  /* cells burned since the last census (forest fire) */
+    std::vector<int>* _uf_parent;  /* union-find parent of each cell, or of each label when merging */
+    std::vector<long>* _uf_size;   /* union-find set sizes */
+    std::vector<long>* _block;     /* clusters reaching the edges of the local block */
+    std::vector<long>* _block_in;  /* block received from below */
+    std::vector<long>* _block_out; /* merged block */
+    long _census_count;  /* censuses taken */
+    double _census_time; /* seconds spent counting clusters */
+
+    std::string _query_path;   /* region query socket (empty: none) */
+    int _query_listen;   /* listening socket (master) */
+    int _query_conn;     /* query client, or -1 (master) */
+    std::string _query_in;     /* bytes from the client not yet parsed (master) */
+    int _query[6];       /* requested region: row, column, rows, columns, zoom, every (0: once); rows 0 for none */
+    std::vector<unsigned char>* _query_out; /* region sent to the client (master) */
+    std::vector<int>* _query_counts; /* state counts per block of the local rows (zoomed) */
+    std::vector<int>* _query_sum;    /* state counts per block of the region (master) */
+    std::vector<MPI_Request>* _query_requests; /* receives of region rows, one per rank (master) */
+    MPI_Datatype _query_type;  /* local rows of the region in place */
+    int _query_shape[3]; /* rows, columns and stride _query_type was built for */
+    long _query_count;   /* regions sent to the client */
+
+    std::vector<unsigned long>* _hashes; /* fingerprints of the last steps (ring) */
+    std::vector<int>* _hash_gens;        /* generation of each fingerprint */
+    long _hash_count;    /* fingerprints taken */
+    int _period;         /* period of the steady state (0 while none is known) */
+    int _onset;          /* first generation of the steady state */
+    long _skipped;       /* generations jumped over */
 
     std::vector<Row*>* _nodes; /* all local nodes */
     std::vector<Row*>* _node_map; /* generated map nodes */
     std::vector<std::string>* _map; /* initial map from file */
 
 public:
-    State(int argc, char **argv);
+    State(int argc, char **argv, MPI_Comm comm, Screen* screen);
+    State(std::istream& sim, MPI_Comm comm, Screen* screen = nullptr, State* spare = nullptr);
+    ~State();
+    void release();
 
     /* initialization */
     void get_map();
     void init_window();
     void adjust_window_width(int w);
-    void init_sim(std::string filename);
+    void init_state(MPI_Comm comm, Screen* screen);
+    void init_sim(std::istream& file);
+    void read_options(std::istream& file);
+    void set_option(std::string key, std::string value);
+    void init_seed();
+    void init_terrain();
     void generate_nodes(int min, int max, double density);
     void build_nodes();
     void set_bounds();
+    void init_wire(int mode);
+    int pack_cells(const unsigned char* cells, int rows, int stride, std::vector<unsigned char>* buf);
+    void recv_cells(unsigned char* cells, int rows, int stride, int source);
     void transmit_nodes();
+    void transmit_rows();
     void update_neighbors();
     void apply_simulation();
     void check(int argc, char** argv);
     void fail(std::string e);
     void inc_n();
+    bool running();
+    void advance(int n);
+
+    /* blocked.cpp */
+    void build_grid();
+    bool take_grid(int rows);
+    void free_grid();
+    void transmit_grid();
+    void step_blocked();
+    void sync_nodes();
+
+    /* tune.cpp */
+    double trial();
+    void tune();
+
+    /* halo.cpp */
+    Grid* share_grid(int rows);
+    Grid* shared_grid(int rank);
+    void expose_grid();
+    MPI_Aint rma_offset(int rank, bool below);
+    void transmit_rma();
+
+    /* frontier.cpp */
+    void build_frontier();
+    void transmit_frontier();
+    void receive_changes(int source, int row, std::vector<int>* remote);
+    void change_cell(int i, int j, int s);
+    void ignite_cell(int i, int j);
+    void step_frontier();
+
+    /* delta.cpp */
+    void build_delta();
+    void count_change(int c, int d, unsigned char* counts, unsigned char* marked);
+    void step_delta();
+
+    /* sparse.cpp */
+    int tile_owner(long x, long y);
+    void build_sparse();
+    void transmit_sparse();
+    void step_sparse();
+    void sync_sparse();
+
+    /* viewport.cpp */
+    void init_viewport();
+    void reduce_strip();
+    int reduce_block(const int* counts);
+    void draw_viewport();
+
+    /* frames.cpp */
+    void init_frames();
+    void encode_frame();
+    void export_frame();
+
+    /* clusters.cpp */
+    void init_clusters();
+    void mark_scars();
+    void label_strip(const unsigned char* mask, long* hist, long* stats);
+    void merge_blocks(long* hist, long* stats);
+    void count_clusters(const unsigned char* mask, const char* kind);
+    void census();
+
+    /* query.cpp */
+    void init_query();
+    void query_reply(const std::string& head, const unsigned char* body, long n);
+    void poll_query();
+    void region(const int* q, unsigned char* out);
+    void serve_query();
+
+    /* steady.cpp */
+    void init_steady();
+    void fingerprint(unsigned long* sums);
+    void check_steady();
+    void digest(unsigned long* sums, int bands);
 
     /* getters */
     Row* get_row(int i);
     int get_node_status(int row, int n);
     int get_node_color(int r, int n);
     int get_current_generation();
+    int get_generation();
 
     /* display.cpp */
-    std::string display_map(int delay);
-    void display_exit(std::string out);
+    const std::string& display_map(int delay);
+    void display_exit(const std::string& msg = "Simulation Complete! Press [Enter] to continue.");
+    void display_summary();
+    friend class Simulation;
+    friend class Service;
+    friend class Verifier;
     friend std::ostream& operator<<(std::ostream&, const State&);
     friend std::string& operator += (std::string&, const State&);
 };
@@ -0,0 +1,280 @@
+//
+// Verification mode (forest --verify a.sim b.sim [ranks a] [ranks b]).
+//
+// Two configurations of the same simulation, say the node engine on one rank against
+// the blocked engine on four, run one after the other from the same seed. After every
+// generation each rank hashes its rows into VERIFY_BANDS bands of the map and one sum
+// reduction combines them, so the checksums depend only on the cells. Master keeps the
+// first run's checksums and compares the second run's at every generation both produce
+// (the blocked engine produces one per block). At the first mismatch both runs are
+// replayed to that generation, and the rows of the first band that differs are read
+// from each to find the first cell that differs.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "defs.h"
+#include "State.h"
+#include "Verifier.h"
+
+using namespace std;
+
+#define VERIFY_BANDS 64   /* row bands checksummed per generation */
+
+
+/**
+ * Value of a setting in .sim text ("name:" line, then the value line)
+ * @param text .sim text
+ * @param name setting
+ * @return value, or "" if the setting is missing
+ */
+static string setting(const string& text, const string& name) {
+    istringstream lines(text);
+    string line;
+    while (getline(lines, line)) {
+        if (line == name + ":" && getline(lines, line)) return line;
+    }
+    return "";
+}
+
+
+/**
+ * Constructor. Master reads both files and picks the seed: the first file's, else the
+ * second's, else a random one. Collective.
+ * @param a .sim file of the first configuration
+ * @param b .sim file of the second
+ * @param ranks_a ranks running the first (0: all)
+ * @param ranks_b ranks running the second (0: all)
+ * @param comm ranks available
+ * @return Verifier object
+ */
+Verifier::Verifier(const string& a, const string& b, int ranks_a, int ranks_b, MPI_Comm comm) {
+    _comm = comm;
+    MPI_Comm_rank(_comm, &_rank);
+    MPI_Comm_size(_comm, &_size);
+    _name[0] = a;
+    _name[1] = b;
+    _ranks[0] = (ranks_a > 0) ? ranks_a : _size;
+    _ranks[1] = (ranks_b > 0) ? ranks_b : _size;
+    _gens = new vector<int>();
+    _sums = new vector<unsigned long>();
+    _compared = 0;
+
+    int ok = _ranks[0] <= _size && _ranks[1] <= _size;
+    for (int k = 0; k < 2 && _rank == 0; k++) {
+        ifstream in(_name[k]);
+        ostringstream text;
+        text << in.rdbuf();
+        _text[k] = text.str();
+        if (!in) ok = 0;
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, _comm);
+    if (!ok) {
+        delete _gens;
+        delete _sums;
+        throw runtime_error((_ranks[0] <= _size && _ranks[1] <= _size) ? ERROR_FILE : ERROR_RANKS);
+    }
+    for (string& text : _text) {
+        int n = (int) text.size();
+        MPI_Bcast(&n, 1, MPI_INT, 0, _comm);
+        text.resize((unsigned long) n);
+        MPI_Bcast(&text[0], n, MPI_CHAR, 0, _comm);
+    }
+
+    string seed = setting(_text[0], "seed");
+    if (seed.empty()) seed = setting(_text[1], "seed");
+    if (seed.empty() && _rank == 0) seed = to_string(random_device()());
+    _seed = seed.empty() ? 0 : stoul(seed);
+    MPI_Bcast(&_seed, 1, MPI_UNSIGNED_LONG, 0, _comm);
+    for (string& text : _text) text += "\nseed:\n" + to_string(_seed) + "\ndisplay:\n0\nsteady:\noff\n";
+    _generations = min(stoi(setting(_text[0], "generations")), stoi(setting(_text[1], "generations")));
+}
+
+
+Verifier::~Verifier() {
+    delete _gens;
+    delete _sums;
+}
+
+
+/**
+ * Sets up one configuration on its ranks. Collective; every rank learns whether the
+ * configuration could be built.
+ * @param k configuration
+ * @param group ranks running it, set (MPI_COMM_NULL on the others)
+ * @return its state, or nullptr on the ranks not running it
+ */
+State* Verifier::start(int k, MPI_Comm* group) {
+    MPI_Comm_split(_comm, (_rank < _ranks[k]) ? 0 : MPI_UNDEFINED, _rank, group);
+    State* s = nullptr;
+    string error;
+    if (*group != MPI_COMM_NULL) {
+        try {
+            istringstream text(_text[k]);
+            s = new State(text, *group);
+            s->_generations = _generations;
+        } catch (exception& e) {
+            error = e.what();
+        }
+    }
+    int failed = !error.empty(), any;
+    MPI_Allreduce(&failed, &any, 1, MPI_INT, MPI_MAX, _comm);
+    if (any) {
+        delete s;
+        if (*group != MPI_COMM_NULL) MPI_Comm_free(group);
+        throw runtime_error(_name[k] + ": " + (failed ? error : "setup failed"));
+    }
+    if (s != nullptr && _rank == 0) {
+        const char* engine[] = {"node", "blocked", "frontier", "sparse", "delta"};
+        const char* halo[] = {"p2p", "shm", "rma"};
+        ostringstream setup;
+        setup << engine[s->_engine];
+        if (s->_engine == ENGINE_BLOCKED) setup << ", tile " << s->_tile << ", depth " << s->_depth << ", halo " << halo[s->_halo];
+        if (s->_kernel == KERNEL_TABLE) setup << ", table kernel";
+        setup << ", " << _ranks[k] << ((_ranks[k] == 1) ? " rank" : " ranks");
+        _setup[k] = setup.str();
+    }
+    return s;
+}
+
+
+/**
+ * Tears one configuration down. Collective over its ranks.
+ * @param s its state (nullptr on the ranks not running it)
+ * @param group its ranks
+ */
+void Verifier::finish(State* s, MPI_Comm* group) {
+    delete s;
+    if (*group != MPI_COMM_NULL) MPI_Comm_free(group);
+}
+
+
+/**
+ * Advances a configuration by one step, as the main loop does. Collective over its ranks.
+ * @param s state
+ * @return generation produced
+ */
+int Verifier::step(State* s) {
+    s->transmit_nodes();
+    s->update_neighbors();
+    s->apply_simulation();
+    s->inc_n();
+    return s->_current - 1;
+}
+
+
+/**
+ * Runs a configuration again to a generation and reads one band of rows. Collective.
+ * @param k configuration
+ * @param gen generation
+ * @param band band
+ * @param rows cells of the band, set (master)
+ * @param shape first row of the band, map width and map height, set
+ * @return false if the configuration did not produce the generation
+ */
+bool Verifier::replay(int k, int gen, int band, vector<unsigned char>* rows, int* shape) {
+    MPI_Comm group;
+    State* s = start(k, &group);
+    int at = 0;
+    if (s != nullptr) {
+        while (at < gen && s->running()) at = step(s);
+        int height = (s->_height + VERIFY_BANDS - 1) / VERIFY_BANDS;
+        int q[5] = {band * height, 0, min(height, s->_height - band * height), s->_width, 1};
+        shape[0] = q[0];
+        shape[1] = q[3];
+        shape[2] = s->_height;
+        if (_rank == 0) rows->resize((unsigned long) (q[2] * q[3]));
+        s->region(q, (_rank == 0) ? rows->data() : nullptr);
+    }
+    finish(s, &group);
+    return at == gen;
+}
+
+
+/**
+ * Runs both configurations and prints the verdict (master). Collective.
+ * @return true if every generation compared matched
+ */
+bool Verifier::run() {
+    unsigned long sums[VERIFY_BANDS + 1];
+    MPI_Comm group;
+
+    /* First configuration: keep its checksums */
+    State* s = start(0, &group);
+    if (s != nullptr) {
+        for (int gen = 0; ; gen = step(s)) {
+            s->digest(sums, VERIFY_BANDS);
+            if (_rank == 0) {
+                _gens->push_back(gen);
+                _sums->insert(_sums->end(), sums, sums + VERIFY_BANDS + 1);
+            }
+            if (!s->running()) break;
+        }
+    }
+    finish(s, &group);
+
+    /* Second configuration: compare at every generation both produce */
+    int found[2] = {-1, -1};   /* generation and band of the first mismatch */
+    s = start(1, &group);
+    if (s != nullptr) {
+        unsigned long next = 0;
+        for (int gen = 0; ; gen = step(s)) {
+            s->digest(sums, VERIFY_BANDS);
+            if (_rank == 0) {
+                while (next < _gens->size() && _gens->at(next) < gen) next++;
+                if (next < _gens->size() && _gens->at(next) == gen) {
+                    const unsigned long* ref = _sums->data() + next * (VERIFY_BANDS + 1);
+                    _compared++;
+                    for (int b = 0; b < VERIFY_BANDS && found[0] < 0; b++) {
+                        if (ref[b] != sums[b]) { found[0] = gen; found[1] = b; }
+                    }
+                }
+            }
+            MPI_Bcast(found, 2, MPI_INT, 0, group);
+            if (found[0] >= 0 || !s->running()) break;
+        }
+    }
+    finish(s, &group);
+    MPI_Bcast(found, 2, MPI_INT, 0, _comm);
+
+    if (_rank == 0) {
+        cout << "Verify:      " << _name[0] << " (" << _setup[0] << ") against " << _name[1]
+             << " (" << _setup[1] << "), seed " << _seed << endl;
+    }
+    if (found[0] < 0) {
+        if (_rank == 0) {
+            cout << "Match:       " << _generations << " generations, " << _compared
+                 << " compared, final checksum " << hex << sums[VERIFY_BANDS] << dec << endl;
+        }
+        return true;
+    }
+
+    /* Trace the mismatch to its first cell */
+    vector<unsigned char> rows[2];
+    int shape[2][3] = {{0, 0, 0}, {0, 0, 0}};
+    bool again = replay(0, found[0], found[1], &rows[0], shape[0]);
+    again = replay(1, found[0], found[1], &rows[1], shape[1]) && again;
+    if (_rank == 0) {
+        unsigned long c = 0;
+        while (c < min(rows[0].size(), rows[1].size()) && rows[0][c] == rows[1][c]) c++;
+        cout << "Diverged:    generation " << found[0] << ", band " << found[1] << " of " << VERIFY_BANDS;
+        if (shape[0][1] != shape[1][1] || rows[0].size() != rows[1].size()) cout << "; the maps differ in size" << endl;
+        else if (!again || c == rows[0].size()) cout << "; not reproduced on replay (a run is not deterministic)" << endl;
+        else {
+            int row = shape[0][0] + (int) c / shape[0][1];
+            int owner[2] = {0, 0};   /* rank whose strip holds the row in each run */
+            for (int k = 0; k < 2; k++) {
+                while (owner[k] + 1 < _ranks[k] && get<1>(get_bounds(_ranks[k], owner[k], shape[k][2])) <= row) owner[k]++;
+            }
+            cout << endl << "First cell:  (" << row << ", " << (int) c % shape[0][1] << "), state "
+                 << (int) rows[0][c] << " in " << _name[0] << " (strip of rank " << owner[0] << "), "
+                 << (int) rows[1][c] << " in " << _name[1] << " (strip of rank " << owner[1] << ")" << endl;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef FOREST_VERIFIER_H
+#define FOREST_VERIFIER_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+class State;
+
+/**
+ * Verification of one engine configuration against another: both run from the same
+ * seed, on as many ranks as each is given, every generation both produce is compared by
+ * banded checksums, and the first divergence is traced to its first differing cell.
+ */
+class Verifier {
+    MPI_Comm _comm;      /* all ranks */
+    int _rank;
+    int _size;
+    std::string _name[2];   /* file of each configuration */
+    std::string _text[2];   /* .sim text of each, seeded and headless */
+    std::string _setup[2];  /* engine settings of each (master) */
+    int _ranks[2];       /* ranks running each */
+    int _generations;    /* generations compared (the fewer of the two) */
+    unsigned long _seed; /* seed of both runs */
+    std::vector<int>* _gens;            /* generations the first produced (master) */
+    std::vector<unsigned long>* _sums;  /* their checksums (master) */
+    long _compared;      /* generations compared */
+
+    State* start(int k, MPI_Comm* group);
+    void finish(State* s, MPI_Comm* group);
+    int step(State* s);
+    bool replay(int k, int gen, int band, std::vector<unsigned char>* rows, int* shape);
+
+public:
+    Verifier(const std::string& a, const std::string& b, int ranks_a, int ranks_b, MPI_Comm comm);
+    ~Verifier();
+    bool run();
+};
+#endif //FOREST_VERIFIER_H
@@ -0,0 +1,151 @@
+//
+// Compact wire format for cell states sent between ranks. Each message is either a
+// bit-packed block (states fit in 1 or 2 bits) or, when it is smaller, a run-length
+// encoding, which wins on mostly-empty rows. The choice is made per message.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "Wire.h"
+
+using namespace std;
+
+
+/**
+ * Bits per cell for a simulation mode
+ * @param mode simulation mode
+ * @return 2 for forest fire (three states), 1 otherwise (dead / alive)
+ */
+int wire_bits(int mode) {
+    return (mode == 1) ? 2 : 1;
+}
+
+
+/**
+ * Largest encoding of a block of cells, for sizing buffers
+ * @param cells number of cells
+ * @return bytes
+ */
+int wire_max(int cells) {
+    return 1 + (cells * 2 + 7) / 8;
+}
+
+
+/**
+ * @param v run value
+ * @return bytes taken by v as a varint
+ */
+static int varint_size(unsigned long v) {
+    int n = 1;
+    while (v >= 0x80) { v >>= 7; n++; }
+    return n;
+}
+
+
+/**
+ * Writes a varint
+ * @param out buffer
+ * @param k write position
+ * @param v value
+ * @return next write position
+ */
+static int put_varint(unsigned char* out, int k, unsigned long v) {
+    while (v >= 0x80) { out[k++] = (unsigned char) (v | 0x80); v >>= 7; }
+    out[k++] = (unsigned char) v;
+    return k;
+}
+
+
+/**
+ * Encodes a block of cells
+ * @param cells first cell
+ * @param rows rows in the block
+ * @param width cells per row
+ * @param stride distance between rows in cells
+ * @param bits bits per cell in the bit-packed format
+ * @param out buffer of at least wire_max(rows * width) bytes
+ * @return bytes written
+ */
+int wire_pack(const unsigned char* cells, int rows, int width, int stride, int bits, unsigned char* out) {
+    int n = rows * width;
+    int packed = (n * bits + 7) / 8;
+
+    /* Size of the run-length encoding */
+    int rle = 0;
+    unsigned long run = 0;
+    int state = -1;
+    for (int i = 0; i < rows && rle < packed; i++) {
+        const unsigned char* r = cells + i * stride;
+        for (int j = 0; j < width; j++) {
+            if (r[j] == state) { run++; continue; }
+            if (run > 0) rle += varint_size(run << 2);
+            state = r[j];
+            run = 1;
+        }
+    }
+    if (run > 0) rle += varint_size(run << 2);
+
+    if (rle < packed) {
+        out[0] = WIRE_RLE;
+        int k = 1;
+        run = 0;
+        state = -1;
+        for (int i = 0; i < rows; i++) {
+            const unsigned char* r = cells + i * stride;
+            for (int j = 0; j < width; j++) {
+                if (r[j] == state) { run++; continue; }
+                if (run > 0) k = put_varint(out, k, (run << 2) | (unsigned long) state);
+                state = r[j];
+                run = 1;
+            }
+        }
+        if (run > 0) k = put_varint(out, k, (run << 2) | (unsigned long) state);
+        return k;
+    }
+
+    out[0] = WIRE_BITS;
+    memset(out + 1, 0, (size_t) max(packed, 0));
+    int k = 0;
+    for (int i = 0; i < rows; i++) {
+        const unsigned char* r = cells + i * stride;
+        for (int j = 0; j < width; j++, k += bits) out[1 + k / 8] |= (unsigned char) (r[j] << (k % 8));
+    }
+    return 1 + packed;
+}
+
+
+/**
+ * Decodes a block of cells
+ * @param in message
+ * @param bytes message length
+ * @param rows rows in the block
+ * @param width cells per row
+ * @param stride distance between rows in cells
+ * @param bits bits per cell in the bit-packed format
+ * @param cells first cell to write
+ */
+void wire_unpack(const unsigned char* in, int bytes, int rows, int width, int stride, int bits, unsigned char* cells) {
+    if (in[0] == WIRE_RLE) {
+        int i = 0, j = 0;
+        int k = 1;
+        while (k < bytes) {
+            unsigned long v = 0;
+            int shift = 0;
+            while (in[k] & 0x80) { v |= (unsigned long) (in[k++] & 0x7f) << shift; shift += 7; }
+            v |= (unsigned long) in[k++] << shift;
+            unsigned char s = (unsigned char) (v & 3);
+            for (unsigned long run = v >> 2; run > 0; run--) {
+                cells[i * stride + j] = s;
+                if (++j == width) { j = 0; i++; }
+            }
+        }
+        return;
+    }
+
+    int mask = (1 << bits) - 1;
+    int k = 0;
+    for (int i = 0; i < rows; i++) {
+        unsigned char* r = cells + i * stride;
+        for (int j = 0; j < width; j++, k += bits) r[j] = (unsigned char) ((in[1 + k / 8] >> (k % 8)) & mask);
+    }
+}
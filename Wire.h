@@ -0,0 +1,12 @@
+#ifndef FOREST_WIRE_H
+#define FOREST_WIRE_H
+
+/* Wire formats, stored in the first byte of every packed message */
+#define WIRE_BITS 0   /* fixed-width fields: 1 bit (Conway) or 2 bits (forest) per cell */
+#define WIRE_RLE 1    /* varint runs: (run length << 2) | state */
+
+int wire_bits(int mode);
+int wire_max(int cells);
+int wire_pack(const unsigned char* cells, int rows, int width, int stride, int bits, unsigned char* out);
+void wire_unpack(const unsigned char* in, int bytes, int rows, int width, int stride, int bits, unsigned char* cells);
+#endif //FOREST_WIRE_H
@@ -0,0 +1,221 @@
+//
+// Sparse tiled world of the sparse engine: the tiles a rank owns, indexed by their
+// coordinates in an open-addressing hash table.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "World.h"
+
+using namespace std;
+
+#define EMPTY_KEY 0xffffffffffffffffUL   /* unused slot */
+
+
+/**
+ * Tile coordinate of a cell coordinate, rounding down for negative cells
+ * @param cell cell row or column
+ * @return long
+ */
+long tile_of(long cell) {
+    return (cell >= 0) ? cell / TILE : -((-cell + TILE - 1) / TILE);
+}
+
+
+/**
+ * Constructor
+ * @return TileMap object
+ */
+TileMap::TileMap() {
+    _keys = new vector<unsigned long>(64, EMPTY_KEY);
+    _values = new vector<int>(64);
+    _mask = 63;
+    _count = 0;
+}
+
+
+TileMap::~TileMap() {
+    delete _keys;
+    delete _values;
+}
+
+
+/**
+ * Packs tile coordinates into a key. Coordinates wrap at 32 bits.
+ * @param x tile column
+ * @param y tile row
+ * @return unsigned long
+ */
+unsigned long TileMap::key(long x, long y) {
+    return ((unsigned long) (unsigned int) x << 32) | (unsigned int) y;
+}
+
+
+/**
+ * @param k key
+ * @return first slot to probe for k
+ */
+static unsigned long slot(unsigned long k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdUL;
+    return k ^ (k >> 33);
+}
+
+
+/**
+ * Empties the table, keeping its slots
+ */
+void TileMap::clear() {
+    fill(_keys->begin(), _keys->end(), EMPTY_KEY);
+    _count = 0;
+}
+
+
+/**
+ * Maps a tile to a value. The table doubles when it is half full.
+ * @param x tile column
+ * @param y tile row
+ * @param value index
+ */
+void TileMap::put(long x, long y, int value) {
+    if (2 * (_count + 1) > (int) _keys->size()) {
+        vector<unsigned long>* keys = _keys;
+        vector<int>* values = _values;
+        _keys = new vector<unsigned long>(2 * keys->size(), EMPTY_KEY);
+        _values = new vector<int>(2 * keys->size());
+        _mask = _keys->size() - 1;
+        _count = 0;
+        for (unsigned long s = 0; s < keys->size(); s++) {
+            unsigned long k = keys->at(s);
+            if (k != EMPTY_KEY) put((int) (k >> 32), (int) (k & 0xffffffffUL), values->at(s));
+        }
+        delete keys;
+        delete values;
+    }
+    unsigned long k = key(x, y);
+    unsigned long s = slot(k) & _mask;
+    while (_keys->at(s) != EMPTY_KEY && _keys->at(s) != k) s = (s + 1) & _mask;
+    if (_keys->at(s) == EMPTY_KEY) _count++;
+    _keys->at(s) = k;
+    _values->at(s) = value;
+}
+
+
+/**
+ * @param x tile column
+ * @param y tile row
+ * @return value of the tile, or -1
+ */
+int TileMap::get(long x, long y) {
+    unsigned long k = key(x, y);
+    for (unsigned long s = slot(k) & _mask; _keys->at(s) != EMPTY_KEY; s = (s + 1) & _mask) {
+        if (_keys->at(s) == k) return _values->at(s);
+    }
+    return -1;
+}
+
+
+/**
+ * @return tiles in the table
+ */
+int TileMap::count() {
+    return _count;
+}
+
+
+/**
+ * Constructor
+ * @return World object
+ */
+World::World() {
+    _tiles = new vector<Tile*>();
+    _pool = new vector<Tile*>();
+    _index = new TileMap();
+    _peak = 0;
+}
+
+
+World::~World() {
+    for (Tile* t : *_tiles) delete t;
+    for (Tile* t : *_pool) delete t;
+    delete _tiles;
+    delete _pool;
+    delete _index;
+}
+
+
+/**
+ * @param x tile column
+ * @param y tile row
+ * @return the tile, or nullptr if it is not held
+ */
+Tile* World::find(long x, long y) {
+    int k = _index->get(x, y);
+    return (k < 0) ? nullptr : _tiles->at((unsigned long) k);
+}
+
+
+/**
+ * Holds an empty tile, unless the tile is already held
+ * @param x tile column
+ * @param y tile row
+ * @return the tile
+ */
+Tile* World::add(long x, long y) {
+    Tile* t = find(x, y);
+    if (t != nullptr) return t;
+    if (_pool->empty()) t = new Tile();
+    else { t = _pool->back(); _pool->pop_back(); }
+    t->x = x;
+    t->y = y;
+    memset(t->rows, 0, sizeof(t->rows));
+    _index->put(x, y, (int) _tiles->size());
+    _tiles->push_back(t);
+    _peak = max(_peak, (int) _tiles->size());
+    return t;
+}
+
+
+/**
+ * Returns the empty tiles to the pool. The pool is kept no larger than the live tiles,
+ * so tiles are reused as activity moves, and freed as it dies down.
+ */
+void World::prune() {
+    unsigned long n = 0;
+    for (Tile* t : *_tiles) {
+        bool live = false;
+        for (int i = 0; i < TILE && !live; i++) live = t->rows[i] != 0;
+        if (live) _tiles->at(n++) = t;
+        else _pool->push_back(t);
+    }
+    if (n == _tiles->size()) return;
+    _tiles->resize(n);
+    while (_pool->size() > max(n, (unsigned long) 1)) { delete _pool->back(); _pool->pop_back(); }
+    _index->clear();
+    for (unsigned long k = 0; k < n; k++) _index->put(_tiles->at(k)->x, _tiles->at(k)->y, (int) k);
+}
+
+
+/**
+ * @return tiles held
+ */
+int World::size() {
+    return (int) _tiles->size();
+}
+
+
+/**
+ * @return most tiles held at once
+ */
+int World::peak() {
+    return _peak;
+}
+
+
+/**
+ * @param k index
+ * @return k-th tile held
+ */
+Tile* World::at(int k) {
+    return _tiles->at((unsigned long) k);
+}
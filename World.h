@@ -0,0 +1,82 @@
+#ifndef FOREST_WORLD_H
+#define FOREST_WORLD_H
+
+#include <vector>
+
+#define TILE 64   /* tile edge in cells (bits of a row word) */
+
+/**
+ * Square of TILE x TILE Conway cells, bit-packed: bit j of row i is cell
+ * (y * TILE + i, x * TILE + j)
+ */
+struct Tile {
+    long x;                        /* tile column */
+    long y;                        /* tile row */
+    unsigned long rows[TILE];      /* cells */
+};
+
+/**
+ * Edge cells of a tile, all a neighboring tile needs to step. Bit i of left / right is
+ * row i's first / last cell.
+ */
+struct Border {
+    long x;
+    long y;
+    unsigned long top;
+    unsigned long bottom;
+    unsigned long left;
+    unsigned long right;
+};
+
+/**
+ * One row word of a tile, for moving cells between the tiles and the dense strips
+ */
+struct Patch {
+    long x;
+    long y;
+    long i;                        /* row in the tile */
+    unsigned long bits;
+};
+
+/**
+ * Hash table from tile coordinates to an index, with open addressing. Only grows.
+ */
+class TileMap {
+    std::vector<unsigned long>* _keys;
+    std::vector<int>* _values;
+    unsigned long _mask;           /* slots - 1 */
+    int _count;
+
+public:
+    TileMap();
+    ~TileMap();
+    static unsigned long key(long x, long y);
+    void clear();
+    void put(long x, long y, int value);
+    int get(long x, long y);
+    int count();
+};
+
+/**
+ * Unbounded Conway world of the tiles one rank owns. Tiles are taken from a pool and
+ * returned to it when they empty, so memory follows the live area.
+ */
+class World {
+    std::vector<Tile*>* _tiles;    /* live tiles */
+    std::vector<Tile*>* _pool;     /* freed tiles */
+    TileMap* _index;               /* tile coordinates -> _tiles index */
+    int _peak;                     /* most tiles held at once */
+
+public:
+    World();
+    ~World();
+    Tile* find(long x, long y);
+    Tile* add(long x, long y);
+    void prune();
+    int size();
+    int peak();
+    Tile* at(int k);
+};
+
+long tile_of(long cell);
+#endif //FOREST_WORLD_H
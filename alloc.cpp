@@ -0,0 +1,56 @@
+//
+// Allocation accounting, so that the run summary can report how many heap allocations
+// each rank made after startup. The forest binary counts through its operator new
+// (newdelete.cpp); programs embedding the library keep their own allocator and
+// read zero.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include "defs.h"
+
+using namespace std;
+
+static atomic<unsigned long> allocations(0);   /* operator new calls */
+static atomic<unsigned long> allocated(0);     /* bytes requested */
+
+
+/**
+ * Counts one heap allocation
+ * @param n bytes requested
+ */
+void alloc_note(size_t n) {
+    allocations++;
+    allocated += n;
+}
+
+
+/**
+ * @return heap allocations made through operator new so far
+ */
+unsigned long alloc_count() {
+    return allocations;
+}
+
+
+/**
+ * @return bytes requested through operator new so far
+ */
+unsigned long alloc_bytes() {
+    return allocated;
+}
+
+
+/**
+ * Resident set size of this process
+ * @return long resident KB (0 if unavailable)
+ */
+long rss_kb() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
@@ -0,0 +1,188 @@
+//
+// Micro-benchmarks of the hot paths: neighbor update, rule application per engine and
+// mode, whole generations, halo exchange per backend, steady-state fingerprint, frame
+// gather, and the throughput of independent replicas on threads of one process.
+//
+//     make bench
+//     mpirun -np <num_threads> ./bench [height] [width] [iterations]
+//
+// Every benchmark repeats one phase on a generated map (fixed seed) and reports the
+// time per generation on the slowest rank (per call for phases that do not advance the
+// generation), and for the phases that update cells, cell updates per second over the
+// whole map.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "defs.h"
+#include "Pool.h"
+#include "State.h"
+#include "Screen.h"
+
+using namespace std;
+
+
+/**
+ * Screen that draws nothing, so that frame gathers can be timed without a terminal
+ */
+class Blank : public Screen {
+public:
+    void open() {}
+    int lines() { return 50; }
+    int cols() { return 160; }
+    void resize(int rows, int cols) {}
+    void clear() {}
+    void text(int row, int col, const char* s, int n) {}
+    void cell(int row, int col, char c, int color) {}
+    void show() {}
+    void close(int row, int col, const char* msg) {}
+};
+
+
+static int height = 256;
+static int width = 256;
+static int iterations = 20;
+static int me;   /* this rank */
+
+#define REPLICAS 16   /* simulations per replica batch */
+
+
+/**
+ * .sim text of a benchmark map
+ * @param mode 1 forest fire, 2 Conway's Game of Life
+ * @param options extra settings, "name:\nvalue\n" pairs
+ * @return string
+ */
+static string sim(int mode, const string& options) {
+    ostringstream s;
+    s << "mode:\n" << mode << "\nheight:\n" << height << "\nwidth:\n" << width << "\ngenerations:\n1000000\n";
+    if (mode == 1) s << "ignition:\n0.0001\ngrowth:\n0.01\ninit density:\n0.6\n";
+    else s << "underpopulation:\n2\noverpopulation:\n3\ngrowth:\n3\ninit density:\n0.3\n";
+    s << "seed:\n1\ndisplay:\n1\nsteady:\noff\n" << options;
+    return s.str();
+}
+
+
+/**
+ * Times one phase and prints a result line
+ * @param name benchmark name
+ * @param mode simulation mode
+ * @param options extra settings
+ * @param cells true if the phase updates every cell once per generation
+ * @param phase the phase, called once untimed, then `iterations` times
+ */
+static void bench(const string& name, int mode, const string& options, bool cells, function<void(State*)> phase) {
+    istringstream text(sim(mode, options));
+    Blank screen;
+    State* s = new State(text, MPI_COMM_WORLD, &screen);
+    s->transmit_nodes();
+    phase(s);
+
+    int first = s->get_generation();
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t = MPI_Wtime();
+    for (int k = 0; k < iterations; k++) phase(s);
+    t = MPI_Wtime() - t;
+    double slowest;
+    MPI_Allreduce(&t, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    int generations = s->get_generation() - first;   /* a blocked call steps a whole block */
+    if (generations == 0) generations = iterations;
+    delete s;
+
+    if (me != 0) return;
+    printf("%-28s %12.1f us", name.c_str(), slowest / generations * 1e6);
+    if (cells) printf(" %12.2f Mcells/s", (double) height * width * generations / slowest / 1e6);
+    printf("\n");
+}
+
+
+/**
+ * One whole generation, as in the main loop
+ * @param s state
+ */
+static void generation(State* s) {
+    s->transmit_nodes();
+    s->update_neighbors();
+    s->apply_simulation();
+    s->inc_n();
+}
+
+
+/**
+ * Runs a batch of independent blocked forest fires on a replica pool (rank 0 alone) and
+ * prints a result line
+ * @param threads pool threads
+ */
+static void replicas(int threads) {
+    if (me != 0) return;
+    Pool pool(threads);
+    vector<string> sims;
+    for (int k = 0; k < REPLICAS; k++) sims.push_back(sim(1, "engine:\nblocked\ndisplay:\n0\nseed:\n" + to_string(k + 1) + "\n"));
+    double t = MPI_Wtime();
+    pool.run(sims, iterations);
+    t = MPI_Wtime() - t;
+    double generations = (double) REPLICAS * iterations;
+    printf("%-28s %12.1f us %12.2f Mcells/s\n", ("replicas/" + to_string(pool.threads())).c_str(),
+           t / generations * 1e6, (double) height * width * generations / t / 1e6);
+}
+
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &me);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (argc > 1) height = atoi(argv[1]);
+    if (argc > 2) width = atoi(argv[2]);
+    if (argc > 3) iterations = atoi(argv[3]);
+    if (me == 0) printf("%d x %d, %d ranks, %d iterations\n", height, width, size, iterations);
+
+    const char* modes[] = {"", "forest", "conway"};
+    for (int mode : {1, 2}) {
+        string m = modes[mode];
+        bench("neighbors/node/" + m, mode, "", true, [](State* s) { s->update_neighbors(); });
+        bench("rules/node/" + m, mode, "", true, [](State* s) { s->apply_simulation(); });
+    }
+
+    for (int mode : {1, 2}) {
+        string m = modes[mode];
+        bench("generation/node/" + m, mode, "", true, generation);
+        bench("generation/blocked/" + m, mode, "engine:\nblocked\n", true, generation);
+        if (mode == 1) bench("generation/frontier/" + m, mode, "engine:\nfrontier\n", true, generation);
+        if (mode == 2) bench("generation/table/" + m, mode, "engine:\nblocked\nkernel:\ntable\n", true, generation);
+        if (mode == 2) bench("generation/delta/" + m, mode, "engine:\ndelta\n", true, generation);
+    }
+
+    bench("halo/node", 1, "", false, [](State* s) { s->transmit_nodes(); });
+    for (const char* backend : {"p2p", "shm", "rma"}) {
+        bench(string("halo/blocked/") + backend, 1, string("engine:\nblocked\nhalo:\n") + backend + "\n", false,
+              [](State* s) { s->transmit_nodes(); });
+    }
+    bench("halo/frontier", 1, "engine:\nfrontier\n", false, [](State* s) { s->transmit_nodes(); });
+
+    for (const char* engine : {"node", "blocked"}) {
+        bench(string("fingerprint/") + engine, 2, string("engine:\n") + engine + "\n", true,
+              [](State* s) { unsigned long sums[1 + VIEW_STATES]; s->fingerprint(sums); });
+    }
+
+    for (int mode : {1, 2}) {
+        string m = modes[mode];
+        bench("gather/full/" + m, mode, "viewport:\noff\n", false, [](State* s) { s->display_map(0); });
+        bench("gather/viewport/" + m, mode, "viewport:\non\n", false, [](State* s) { s->display_map(0); });
+    }
+
+    int cores = max(1, (int) thread::hardware_concurrency());
+    for (int threads = 1; threads < cores; threads *= 2) replicas(threads);
+    replicas(cores);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MPI_Finalize();
+}
@@ -0,0 +1,413 @@
+//
+// Temporally blocked stepping on the flat Grid (engine: blocked).
+//
+// Every `depth` generations, ranks swap `depth` halo rows. Each rank then advances its
+// strip tile by tile: a tile and a `depth`-deep apron are copied into a cache-sized
+// scratch pair, stepped `depth` generations in place (the valid region shrinks by one
+// cell per generation, a trapezoid in time), and only the tile interior is written back.
+// Main memory is read and written once per block instead of twice per generation.
+// Larger than Life (mode 3) reaches `radius` cells per generation, so its halos, aprons
+// and trapezoid slopes are `radius` times as wide. With kernel: table, Conway tiles are
+// stepped 2 x 2 cells at a time from a lookup table of every 4 x 4 neighborhood.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstring>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+#include "Sampler.h"
+
+using namespace std;
+
+/* Rule variables for the grid kernels */
+struct rules {
+    int mode;            /* simulation mode */
+    double v[5];         /* control vector values */
+    unsigned long seed;  /* run seed */
+    const Raster* ignition;  /* ignition probability per cell (nullptr: v[0]) */
+    const Raster* growth;    /* growth probability per cell (nullptr: v[1]) */
+    const unsigned char* table;  /* Conway lookup table (nullptr: cell by cell) */
+};
+
+
+/**
+ * Conway's Game of Life over one row span
+ * @param up row above
+ * @param mid row
+ * @param down row below
+ * @param out next generation of mid
+ * @param from first column
+ * @param to end column
+ * @param r rule variables
+ */
+static void conway_row(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                       unsigned char* out, int from, int to, const rules& r) {
+    int u = (int) r.v[0], o = (int) r.v[1], g = (int) r.v[2];
+    for (int x = from; x < to; x++) {
+        int pop = (up[x - 1] == 1) + (up[x] == 1) + (up[x + 1] == 1)
+                + (mid[x - 1] == 1) + (mid[x + 1] == 1)
+                + (down[x - 1] == 1) + (down[x] == 1) + (down[x + 1] == 1);
+        if (mid[x] == 1) out[x] = (unsigned char) ((pop < u || pop > o) ? 0 : 1);
+        else out[x] = (unsigned char) ((pop == g) ? 1 : 0);
+    }
+}
+
+
+/**
+ * Conway's Game of Life over a region of a tile, 2 x 2 cells per lookup. For each pair of
+ * rows, the 4 cells of every column around them are packed into 4 bits in one pass; the
+ * table index of a block is 4 such columns (the leftmost in the top bits), so moving to
+ * the next block shifts in two new columns. An odd last row or column is stepped cell by
+ * cell.
+ * @param in current generation
+ * @param out next generation
+ * @param W tile row length
+ * @param ylo first row
+ * @param yhi end row
+ * @param xlo first column
+ * @param xhi end column
+ * @param r rule variables
+ * @param columns column nibbles of a row pair (W)
+ */
+static void conway_table(const unsigned char* in, unsigned char* out, int W, int ylo, int yhi, int xlo, int xhi,
+                         const rules& r, unsigned char* columns) {
+    static const unsigned char pairs[4][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};   /* two bits as two cells */
+    int ye = ylo + (yhi - ylo) / 2 * 2;
+    int xe = xlo + (xhi - xlo) / 2 * 2;
+    for (int y = ylo; y < ye; y += 2) {
+        const unsigned char* r0 = in + (y - 1) * W;
+        const unsigned char* r1 = r0 + W;
+        const unsigned char* r2 = r1 + W;
+        const unsigned char* r3 = r2 + W;
+        unsigned char* o0 = out + y * W;
+        unsigned char* o1 = o0 + W;
+        for (int x = xlo - 1; x < xe + 1; x++) {
+            columns[x] = (unsigned char) ((r0[x] == 1) << 3 | (r1[x] == 1) << 2 | (r2[x] == 1) << 1 | (r3[x] == 1));
+        }
+        unsigned index = (unsigned) columns[xlo - 1] << 4 | columns[xlo];
+        for (int x = xlo; x < xe; x += 2) {
+            index = (index << 8 | (unsigned) columns[x + 1] << 4 | columns[x + 2]) & 0xffff;
+            unsigned next = r.table[index];
+            memcpy(o0 + x, pairs[next & 3], 2);
+            memcpy(o1 + x, pairs[next >> 2], 2);
+        }
+        if (xe < xhi) {
+            conway_row(r0, r1, r2, o0, xe, xhi, r);
+            conway_row(r1, r2, r3, o1, xe, xhi, r);
+        }
+    }
+    if (ye < yhi) conway_row(in + (ye - 1) * W, in + ye * W, in + (ye + 1) * W, out + ye * W, xlo, xhi, r);
+}
+
+
+/**
+ * Larger than Life over a region of a tile, with running sums: the live cells of every
+ * row are summed over a sliding window of 2r+1 columns, and those row sums over a sliding
+ * window of 2r+1 rows, so a cell costs the same at any radius. The region must lie at
+ * least r cells inside the tile.
+ * @param in current generation
+ * @param out next generation
+ * @param W tile row length
+ * @param ylo first row
+ * @param yhi end row
+ * @param xlo first column
+ * @param xhi end column
+ * @param r rule variables
+ * @param sums window totals (W) followed by the row sums (W per tile row)
+ */
+static void ltl_tile(const unsigned char* in, unsigned char* out, int W, int ylo, int yhi, int xlo, int xhi,
+                     const rules& r, int* sums) {
+    if (ylo >= yhi || xlo >= xhi) return;
+    int rad = (int) r.v[0];
+    int b1 = (int) r.v[1], b2 = (int) r.v[2], s1 = (int) r.v[3], s2 = (int) r.v[4];
+    int* acc = sums;
+    int* rows = sums + W;
+
+    for (int y = ylo - rad; y < yhi + rad; y++) {
+        const unsigned char* c = in + y * W;
+        int* h = rows + y * W;
+        int s = 0;
+        for (int x = xlo - rad; x <= xlo + rad; x++) s += c[x] == 1;
+        h[xlo] = s;
+        for (int x = xlo + 1; x < xhi; x++) {
+            s += (c[x + rad] == 1) - (c[x - rad - 1] == 1);
+            h[x] = s;
+        }
+    }
+
+    fill(acc + xlo, acc + xhi, 0);
+    for (int y = ylo - rad; y <= ylo + rad; y++) {
+        const int* h = rows + y * W;
+        for (int x = xlo; x < xhi; x++) acc[x] += h[x];
+    }
+    for (int y = ylo; y < yhi; y++) {
+        if (y > ylo) {
+            const int* add = rows + (y + rad) * W;
+            const int* drop = rows + (y - rad - 1) * W;
+            for (int x = xlo; x < xhi; x++) acc[x] += add[x] - drop[x];
+        }
+        const unsigned char* c = in + y * W;
+        unsigned char* o = out + y * W;
+        for (int x = xlo; x < xhi; x++) {
+            int alive = c[x] == 1;
+            int n = acc[x] - alive;
+            o[x] = (unsigned char) (alive ? (n >= s1 && n <= s2) : (n >= b1 && n <= b2));
+        }
+    }
+}
+
+
+/**
+ * Forest fire over one row span. Spread and burn-out are applied to every cell; lightning
+ * and regrowth only at the events the samplers jump to. Events are keyed on the row span,
+ * so overlapping tiles and neighboring ranks agree on every cell they both compute.
+ * Probability rasters are read only at those events, at the cell's own global position.
+ * @param row global row of mid
+ * @param col global column of index 0
+ * @param gen generation being produced
+ * @param lightning lightning sampler
+ * @param growth regrowth candidate sampler
+ */
+static void forest_row(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                       unsigned char* out, int from, int to, const rules& r, long row, long col, long gen,
+                       Sampler& lightning, Sampler& growth) {
+    for (int x = from; x < to; x++) {
+        int c = mid[x];
+        if (c == 1) {
+            bool burning = up[x - 1] == 2 || up[x] == 2 || up[x + 1] == 2
+                        || mid[x - 1] == 2 || mid[x + 1] == 2
+                        || down[x - 1] == 2 || down[x] == 2 || down[x + 1] == 2;
+            out[x] = (unsigned char) (burning ? 2 : 1);
+        }
+        else out[x] = 0;
+    }
+
+    unsigned long strike = stream_seed(r.seed, STREAM_STRIKE);
+    for (lightning.seek(gen, row, col + from, col + to); lightning.next() < col + to; lightning.advance()) {
+        int x = (int) (lightning.next() - col);
+        if (out[x] != 1) continue;
+        if (r.ignition == nullptr || toss_at(strike, gen, row, col + x) * lightning.p() < r.ignition->at(row, col + x)) out[x] = 2;
+    }
+
+    unsigned long accept = stream_seed(r.seed, STREAM_ACCEPT);
+    for (growth.seek(gen, row, col + from, col + to); growth.next() < col + to; growth.advance()) {
+        int x = (int) (growth.next() - col);
+        if (mid[x] != 0) continue;
+        int trees = (up[x - 1] == 1) + (up[x] == 1) + (up[x + 1] == 1)
+                  + (mid[x - 1] == 1) + (mid[x + 1] == 1)
+                  + (down[x - 1] == 1) + (down[x] == 1) + (down[x + 1] == 1);
+        double g = (r.growth == nullptr) ? r.v[1] : r.growth->at(row, col + x);
+        double p = min(1.0, g * (trees + 1));
+        if (toss_at(accept, gen, row, col + x) * growth.p() < p) out[x] = 1;
+    }
+}
+
+
+/**
+ * Marks the burning cells of a tile interior as burned, so that the cluster census sees
+ * every generation of a block
+ * @param tile first interior cell of the tile
+ * @param W tile row length
+ * @param h interior rows
+ * @param w interior columns
+ * @param scar burned cells, at the strip position of the first interior cell
+ * @param width strip row length
+ */
+static void mark_burning(const unsigned char* tile, int W, int h, int w, unsigned char* scar, int width) {
+    for (int y = 0; y < h; y++) {
+        const unsigned char* c = tile + y * W;
+        unsigned char* m = scar + (long) y * width;
+        for (int x = 0; x < w; x++) m[x] |= (unsigned char) (c[x] == 2);
+    }
+}
+
+
+/**
+ * Builds the local strip from the node rows. Halos must be as deep as a block reaches
+ * (depth x radius rows), so the block depth is capped by the shortest strip of any rank.
+ * With halo: shm the strip lives in the node's shared window; with halo: rma it is
+ * exposed in an RMA window.
+ */
+void State::build_grid() {
+    int workers = min(_size, _height);
+    if (_radius > _height / workers) fail(ERROR_RADIUS);
+    _depth = min(_depth, _height / workers / _radius);
+    int edge = _tile + 2 * _depth * _radius;
+    if (!take_grid((int) _nodes->size())) {
+        if (_halo == HALO_SHM) _grid = share_grid((int) _nodes->size());
+        else _grid = new Grid((int) _nodes->size(), _width, _depth * _radius);
+        if (_halo == HALO_RMA && workers > 1) expose_grid();
+        _scratch = new vector<unsigned char>((unsigned long) (2 * edge * edge + edge));   /* tile pair, table kernel row */
+        if (_sim->mode() == 3) _sums = new vector<int>((unsigned long) (edge * edge + edge));
+    }
+    for (int i = 0; i < _grid->rows(); i++) {
+        for (int j = 0; j < _width; j++) _grid->set(i, j, get_node_status(i, j));
+    }
+}
+
+
+/**
+ * Takes over the strip, its shared or RMA window and the tile buffers of the spare
+ * simulation if they have the shape this one needs (service jobs one after another), so
+ * that they are not allocated again. Every rank decides alike.
+ * @param rows local rows
+ * @return false if there is no such strip
+ */
+bool State::take_grid(int rows) {
+    State* s = _spare;
+    if (s == nullptr || s->_grid == nullptr || s->_engine != ENGINE_BLOCKED || s->_comm != _comm) return false;
+    if (s->_height != _height || s->_width != _width || s->_grid->rows() != rows) return false;
+    if (s->_grid->halo() != _depth * _radius || s->_halo != _halo || s->_tile != _tile) return false;
+    if ((s->_sums != nullptr) != (_sim->mode() == 3)) return false;
+    _grid = s->_grid;
+    _scratch = s->_scratch;
+    _sums = s->_sums;
+    _shm_comm = s->_shm_comm;
+    _shm_win = s->_shm_win;
+    _shm_top = s->_shm_top;
+    _shm_bot = s->_shm_bot;
+    _rma_win = s->_rma_win;
+    _rma_group = s->_rma_group;
+    _rma = s->_rma;
+    s->_grid = nullptr;
+    s->_scratch = nullptr;
+    s->_sums = nullptr;
+    s->_shm_top = s->_shm_bot = s->_rma = false;
+    return true;
+}
+
+
+/**
+ * Frees the strip, its shared or RMA window and the tile buffers. Collective when the
+ * strip is in a window.
+ */
+void State::free_grid() {
+    if (_rma) {
+        MPI_Win_free(&_rma_win);
+        MPI_Group_free(&_rma_group);
+        _rma = false;
+    }
+    bool shared = _grid != nullptr && _halo == HALO_SHM && _engine == ENGINE_BLOCKED;
+    delete _grid;
+    _grid = nullptr;
+    if (shared) {
+        MPI_Win_unlock_all(_shm_win);
+        MPI_Win_free(&_shm_win);
+        MPI_Comm_free(&_shm_comm);
+        _shm_top = false;
+        _shm_bot = false;
+    }
+    delete _scratch;
+    delete _sums;
+    _scratch = nullptr;
+    _sums = nullptr;
+}
+
+
+/**
+ * Send / receive as many border rows as the next block will reach, in the packed
+ * wire format. Neighbors sharing the node exchange an empty message instead, as a
+ * handshake before their rows are read in place. Blocks on receive.
+ */
+void State::transmit_grid() {
+    _step = min(_depth, _generations - _current + 1);
+    if (_clusters > 0) _step = min(_step, _clusters - (_current - 1) % _clusters);   /* end on a census */
+    if (_rma) { transmit_rma(); return; }
+    int rows = _grid->rows();
+    int stride = _grid->stride();
+    int n = _step * _radius;
+    bool shared = _shm_top || _shm_bot;
+
+    MPI_Request requests[2];
+    int m = 0;
+    if (shared) MPI_Win_sync(_shm_win);
+    if (_shm_top) MPI_Isend(nullptr,0,MPI_BYTE,_top,0,_comm,&requests[m++]);
+    else if (_top > -1) MPI_Isend(_wire_top->data(),pack_cells(_grid->row(0),n,stride,_wire_top),MPI_UNSIGNED_CHAR,_top,0,_comm,&requests[m++]);
+    if (_shm_bot) MPI_Isend(nullptr,0,MPI_BYTE,_bot,0,_comm,&requests[m++]);
+    else if (_bot > -1) MPI_Isend(_wire_bot->data(),pack_cells(_grid->row(rows - n),n,stride,_wire_bot),MPI_UNSIGNED_CHAR,_bot,0,_comm,&requests[m++]);
+
+    if (_shm_top) MPI_Recv(nullptr,0,MPI_BYTE,_top,0,_comm,MPI_STATUS_IGNORE);
+    else if (_top > -1) recv_cells(_grid->row(-n), n, stride, _top);
+    if (_shm_bot) MPI_Recv(nullptr,0,MPI_BYTE,_bot,0,_comm,MPI_STATUS_IGNORE);
+    else if (_bot > -1) recv_cells(_grid->row(rows), n, stride, _bot);
+    MPI_Waitall(m, requests, MPI_STATUSES_IGNORE);
+    if (shared) MPI_Win_sync(_shm_win);
+}
+
+
+/**
+ * Advances the strip by one block of generations, one tile at a time
+ */
+void State::step_blocked() {
+    Simulator* sim = _sim;
+    rules r;
+    r.mode = sim->mode();
+    r.seed = _seed;
+    for (int k = 0; k < 5; k++) r.v[k] = (k < sim->get_ctrlv()->size()) ? get<0>(sim->get_ctrlv()->at(k)) : 0;
+    r.ignition = sim->ignition_map();
+    r.growth = sim->growth_map();
+    r.table = (_kernel == KERNEL_TABLE) ? sim->life_table() : nullptr;
+
+    int t = _step * _radius;            /* apron: cells the block reaches */
+    int rows = _grid->rows();
+    int lo = (_top == -1) ? 0 : -t;     /* local rows that hold map cells */
+    int hi = (_bot == -1) ? rows : rows + t;
+    int edge = _tile + 2 * _grid->halo();
+    Sampler lightning(_seed, STREAM_LIGHTNING, (r.mode == 1) ? sim->lightning_rate() : 0);
+    Sampler growth(_seed, STREAM_GROWTH, (r.mode == 1) ? sim->growth_rate() : 0);
+    unsigned char* scar = (_scar != nullptr) ? _scar->data() : nullptr;
+
+    for (int ti = 0; ti < rows; ti += _tile) {
+        for (int tj = 0; tj < _width; tj += _tile) {
+            int h = min(_tile, rows - ti);
+            int w = min(_tile, _width - tj);
+            int H = h + 2 * t;
+            int W = w + 2 * t;
+            int y0 = ti - t;    /* grid position of scratch cell (0,0) */
+            int x0 = tj - t;
+            unsigned char* a = _scratch->data();
+            unsigned char* b = a + edge * edge;
+
+            for (int y = 0; y < H; y++) {
+                memcpy(a + y * W, _grid->row(y0 + y) + x0, (size_t) W);
+                memcpy(b + y * W, a + y * W, (size_t) W);
+            }
+
+            for (int k = 1; k <= _step; k++) {
+                long gen = _current + k - 1;
+                int reach = k * _radius;
+                int ylo = max(reach, lo - y0), yhi = min(H - reach, hi - y0);
+                int xlo = max(reach, -x0), xhi = min(W - reach, _width - x0);
+                if (r.mode == 3) ltl_tile(a, b, W, ylo, yhi, xlo, xhi, r, _sums->data());
+                else if (r.table != nullptr) conway_table(a, b, W, ylo, yhi, xlo, xhi, r, _scratch->data() + 2 * edge * edge);
+                else for (int y = ylo; y < yhi; y++) {
+                    unsigned char* up = a + (y - 1) * W;
+                    if (r.mode == 1) forest_row(up, up + W, up + 2 * W, b + y * W, xlo, xhi, r, _start + y0 + y, x0, gen, lightning, growth);
+                    else conway_row(up, up + W, up + 2 * W, b + y * W, xlo, xhi, r);
+                }
+                if (scar != nullptr) mark_burning(b + t * W + t, W, h, w, scar + (long) ti * _width + tj, _width);
+                swap(a, b);
+            }
+
+            for (int y = 0; y < h; y++) memcpy(_grid->next_row(ti + y) + tj, a + (y + t) * W + t, (size_t) w);
+        }
+    }
+    _grid->swap();
+}
+
+
+/**
+ * Copies the strip back into the node rows for display
+ */
+void State::sync_nodes() {
+    for (int i = 0; i < _grid->rows(); i++) {
+        Row* r = _nodes->at((unsigned long) i);
+        for (int j = 0; j < _width; j++) {
+            int s = _grid->get(i, j);
+            r->get_node(j)->set(s, s);
+        }
+        r->sync();
+    }
+}
@@ -0,0 +1,285 @@
+//
+// Cluster census (clusters: N).
+//
+// Every N generations the ranks label the connected clusters of the map (8 neighbors, as
+// fire spreads) and master appends their size distribution to a text file; the map is
+// never gathered. Each rank runs union-find over its own strip and sums the clusters
+// that do not reach its edge rows. The rest stay open: a block of strips is described by
+// the cluster of every cell of its top and bottom rows and the size of each, and pairs of
+// adjacent blocks are merged up a binary tree of ranks, closing the clusters that no
+// longer reach the edge of the merged block, so the merge takes log2(ranks) rounds.
+//
+// Forest fire counts tree clusters, and burned areas: the cells that have burned since
+// the last census, so that each fire that burned out in between is one cluster. Conway's
+// Game of Life and Larger than Life count live clusters.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <fstream>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+#define CLUSTER_TAG 2   /* message tag of the merge rounds */
+
+
+/**
+ * @param parent union-find forest
+ * @param a element
+ * @return root of a, halving the path to it
+ */
+static int find_root(int* parent, int a) {
+    while (parent[a] != a) {
+        parent[a] = parent[parent[a]];
+        a = parent[a];
+    }
+    return a;
+}
+
+
+/**
+ * Joins the sets of a and b, the smaller under the larger
+ * @param parent union-find forest
+ * @param size size of each root's set
+ * @param a element
+ * @param b element
+ */
+static void unite(int* parent, long* size, int a, int b) {
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a == b) return;
+    if (size[a] < size[b]) swap(a, b);
+    parent[b] = a;
+    size[a] += size[b];
+}
+
+
+/**
+ * Gives the set of an edge cell a compact label, the first time the set is met. A root
+ * that has a label keeps it as -(label + 1) in place of its size.
+ * @param parent union-find forest
+ * @param size size of each root's set
+ * @param a element
+ * @param sizes sizes of the labeled sets, appended to
+ * @param k labels given so far, incremented
+ * @return label of a's set
+ */
+static long label(int* parent, long* size, int a, long* sizes, long* k) {
+    int r = find_root(parent, a);
+    if (size[r] > 0) {
+        sizes[*k] = size[r];
+        size[r] = -(++*k);
+    }
+    return -size[r] - 1;
+}
+
+
+/**
+ * Sizes the census buffers and starts the census file
+ */
+void State::init_clusters() {
+    if (_clusters <= 0) return;
+    int rows = (_start < 0) ? 0 : _end - _start;
+    unsigned long cells = (unsigned long) rows * _width;
+    unsigned long sets = max(cells, (unsigned long) (2 * _width + 4));   /* merges reuse the arrays */
+    _mask = new vector<unsigned char>(cells);
+    if (_sim->mode() == 1) _scar = new vector<unsigned char>(cells);
+    _uf_parent = new vector<int>(sets);
+    _uf_size = new vector<long>(sets);
+    for (vector<long>** v : {&_block, &_block_in, &_block_out}) *v = new vector<long>((unsigned long) (3 * _width + 3));
+    if (_rank == 0) {
+        _cluster_out = new ofstream(_cluster_file, ofstream::trunc);
+        *_cluster_out << "# generation kind clusters cells largest, then clusters of 1, 2-3, 4-7, ... cells" << endl;
+    }
+}
+
+
+/**
+ * Marks the cells burning in the current generation as burned. The blocked engine marks
+ * them inside its kernel, every generation of a block.
+ */
+void State::mark_scars() {
+    if (_scar == nullptr || _engine == ENGINE_BLOCKED) return;
+    unsigned char* scar = _scar->data();
+    if (_frontier != nullptr) {
+        for (int c : *_frontier) scar[c] = 1;
+        return;
+    }
+    for (int i = 0; i < _end - _start; i++) {
+        for (int j = 0; j < _width; j++) {
+            int s = (_grid != nullptr) ? _grid->get(i, j) : get_node_status(i, j);
+            if (s == 2) scar[i * _width + j] = 1;
+        }
+    }
+}
+
+
+/**
+ * Labels the clusters of the local strip and describes the ones that reach its edge rows
+ * as a block: label count, labels of the top row, labels of the bottom row (-1 outside
+ * any cluster), then the size of each label
+ * @param mask cells that belong to clusters
+ * @param hist clusters closed per size bin, incremented
+ * @param stats clusters, cells and largest cluster closed, updated
+ */
+void State::label_strip(const unsigned char* mask, long* hist, long* stats) {
+    int rows = _end - _start;
+    int W = _width;
+    int* parent = _uf_parent->data();
+    long* size = _uf_size->data();
+    long* block = _block->data();
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < W; j++) {
+            int c = i * W + j;
+            if (!mask[c]) continue;
+            parent[c] = c;
+            size[c] = 1;
+            if (j > 0 && mask[c - 1]) unite(parent, size, c, c - 1);
+            if (i == 0) continue;
+            for (int x = max(0, j - 1); x <= min(W - 1, j + 1); x++) {
+                if (mask[c - W + x - j]) unite(parent, size, c, c - W + x - j);
+            }
+        }
+    }
+
+    long k = 0;
+    long* sizes = block + 1 + 2 * W;
+    for (int e = 0; e < 2; e++) {
+        int i = (e == 0) ? 0 : rows - 1;
+        for (int j = 0; j < W; j++) {
+            int c = i * W + j;
+            block[1 + e * W + j] = mask[c] ? label(parent, size, c, sizes, &k) : -1;
+        }
+    }
+    block[0] = k;
+    for (int c = 0; c < rows * W; c++) {
+        if (!mask[c] || parent[c] != c || size[c] <= 0) continue;
+        hist[63 - __builtin_clzl((unsigned long) size[c])]++;
+        stats[0]++;
+        stats[1] += size[c];
+        stats[2] = max(stats[2], size[c]);
+    }
+}
+
+
+/**
+ * Merges the block below (_block_in) into the local block (_block), which lies directly
+ * above it, and closes the clusters that reach neither edge of the merged block
+ * @param hist clusters closed per size bin, incremented
+ * @param stats clusters, cells and largest cluster closed, updated
+ */
+void State::merge_blocks(long* hist, long* stats) {
+    int W = _width;
+    long* a = _block->data();
+    long* b = _block_in->data();
+    long* out = _block_out->data();
+    long ka = a[0], kb = b[0];
+    int* parent = _uf_parent->data();
+    long* size = _uf_size->data();
+    for (long s = 0; s < ka + kb; s++) {
+        parent[s] = (int) s;
+        size[s] = (s < ka) ? a[1 + 2 * W + s] : b[1 + 2 * W + s - ka];
+    }
+
+    /* Bottom row of the upper block against the top row of the lower one */
+    for (int j = 0; j < W; j++) {
+        if (a[1 + W + j] < 0) continue;
+        for (int x = max(0, j - 1); x <= min(W - 1, j + 1); x++) {
+            if (b[1 + x] >= 0) unite(parent, size, (int) a[1 + W + j], (int) (ka + b[1 + x]));
+        }
+    }
+
+    long k = 0;
+    long* sizes = out + 1 + 2 * W;
+    for (int j = 0; j < W; j++) out[1 + j] = (a[1 + j] < 0) ? -1 : label(parent, size, (int) a[1 + j], sizes, &k);
+    for (int j = 0; j < W; j++) out[1 + W + j] = (b[1 + W + j] < 0) ? -1 : label(parent, size, (int) (ka + b[1 + W + j]), sizes, &k);
+    out[0] = k;
+    for (long s = 0; s < ka + kb; s++) {
+        if (parent[s] != s || size[s] <= 0) continue;
+        hist[63 - __builtin_clzl((unsigned long) size[s])]++;
+        stats[0]++;
+        stats[1] += size[s];
+        stats[2] = max(stats[2], size[s]);
+    }
+    swap(_block, _block_out);
+}
+
+
+/**
+ * Size distribution of the clusters of one kind of cell, written to the census file by
+ * master. Collective.
+ * @param mask cells that belong to clusters (local strip)
+ * @param kind name of the clusters in the census file
+ */
+void State::count_clusters(const unsigned char* mask, const char* kind) {
+    long hist[CLUSTER_BINS] = {0};
+    long stats[3] = {0, 0, 0};
+    int workers = min(_size, _height);
+    int W = _width;
+    if (_rank < workers) {
+        label_strip(mask, hist, stats);
+        for (int s = 1; s < workers; s *= 2) {
+            if (_rank % (2 * s) == s) {
+                long* block = _block->data();
+                MPI_Send(block,(int) (1 + 2 * W + block[0]),MPI_LONG,_rank - s,CLUSTER_TAG,_comm);
+                break;
+            }
+            if (_rank + s < workers) {
+                MPI_Recv(_block_in->data(),(int) _block_in->size(),MPI_LONG,_rank + s,CLUSTER_TAG,_comm,MPI_STATUS_IGNORE);
+                merge_blocks(hist, stats);
+            }
+        }
+        if (_rank == 0) {   /* what is still open reaches the map edge */
+            long* block = _block->data();
+            for (long s = 0; s < block[0]; s++) {
+                long n = block[1 + 2 * W + s];
+                hist[63 - __builtin_clzl((unsigned long) n)]++;
+                stats[0]++;
+                stats[1] += n;
+                stats[2] = max(stats[2], n);
+            }
+        }
+    }
+
+    long total_hist[CLUSTER_BINS], total_stats[2], largest;
+    MPI_Reduce(hist, total_hist, CLUSTER_BINS, MPI_LONG, MPI_SUM, 0, _comm);
+    MPI_Reduce(stats, total_stats, 2, MPI_LONG, MPI_SUM, 0, _comm);
+    MPI_Reduce(stats + 2, &largest, 1, MPI_LONG, MPI_MAX, 0, _comm);
+    if (_rank == 0) {
+        ofstream& out = *_cluster_out;
+        out << _current + _step - 1 << " " << kind << " " << total_stats[0] << " " << total_stats[1] << " " << largest;
+        int bins = CLUSTER_BINS;
+        while (bins > 0 && total_hist[bins - 1] == 0) bins--;
+        for (int b = 0; b < bins; b++) out << " " << total_hist[b];
+        out << endl;
+    }
+}
+
+
+/**
+ * Counts the clusters of the current generation: trees and burned areas for the forest
+ * fire, live cells otherwise. Collective.
+ */
+void State::census() {
+    double t = MPI_Wtime();
+    if (_engine == ENGINE_SPARSE) sync_sparse();
+    int rows = (_start < 0) ? 0 : _end - _start;
+    unsigned char* mask = _mask->data();
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < _width; j++) {
+            int s = (_grid != nullptr) ? _grid->get(i, j) : get_node_status(i, j);
+            mask[i * _width + j] = (unsigned char) (s == 1);
+        }
+    }
+    if (_sim->mode() == 1) {
+        count_clusters(mask, "trees");
+        count_clusters(_scar->data(), "burned");
+        fill(_scar->begin(), _scar->end(), 0);
+    }
+    else count_clusters(mask, "live");
+    _census_count++;
+    _census_time += MPI_Wtime() - t;
+}
@@ -11,16 +11,66 @@ typedef std::vector<var> ctrlv;
 typedef std::uniform_int_distribution<> dist;
 
 /* Exit */
-void quit();
+void quit(int status = 0);
 
 /* Simulations */
-bool toss(double p); /* For generate_map() */
-int toss(int low, int high); /* For generate_nodes() */
+double toss_at(unsigned long seed, long gen, long row, long col, long k = 0); /* Keyed draw */
+
+/* Library (Simulation.cpp) */
+void init_mpi();
+
+/* Allocation accounting (alloc.cpp) */
+void alloc_note(size_t n);
+unsigned long alloc_count();
+unsigned long alloc_bytes();
+long rss_kb();
 
 /* Display methods */
 std::tuple<int,int> get_bounds(int size, int rank, int height);
 
 
+/* Engines */
+#define ENGINE_NODE 0       /* reference Node / Row engine */
+#define ENGINE_BLOCKED 1    /* temporally blocked Grid engine */
+#define ENGINE_FRONTIER 2   /* frontier-driven forest fire */
+#define ENGINE_SPARSE 3     /* unbounded Conway world of sparse tiles */
+#define ENGINE_DELTA 4      /* change-driven Conway with kept neighbor counts */
+#define DEFAULT_TILE 64     /* blocked engine tile edge (cells) */
+#define DEFAULT_DEPTH 4     /* blocked engine generations per block */
+#define HALO_P2P 0          /* halo rows sent point-to-point */
+#define HALO_SHM 1          /* halo rows read in place on the same node (blocked engine) */
+#define HALO_RMA 2          /* halo rows put by the neighbors, PSCW (blocked engine) */
+#define KERNEL_DIRECT 0     /* blocked Conway tiles stepped cell by cell */
+#define KERNEL_TABLE 1      /* blocked Conway tiles stepped 2 x 2 cells per table lookup */
+#define TUNE_NONE 0         /* tile, depth and halo as given */
+#define TUNE_CACHED 1       /* tile, depth and halo from the tuning file */
+#define TUNE_SEARCHED 2     /* tile, depth and halo found by timed trials */
+
+
+/* Viewport */
+#define VIEW_AUTO 0         /* downsample when the map does not fit the terminal */
+#define VIEW_ON 1           /* always downsample to the terminal */
+#define VIEW_OFF 2          /* never downsample */
+#define REDUCE_MAJORITY 0   /* a block shows its most common state */
+#define REDUCE_ANY 1        /* a block shows the highest state present (any burning) */
+#define VIEW_STATES 3       /* states counted per block */
+
+
+/* Frame export */
+#define FRAME_PPM 0         /* binary RGB netpbm */
+#define FRAME_PGM 1         /* binary grayscale netpbm */
+#define FRAME_PNG 2         /* RGB png, uncompressed */
+
+
+/* Steady state */
+#define STEADY_OFF 0        /* run every generation */
+#define STEADY_STOP 1       /* stop at the first steady state */
+#define STEADY_SKIP 2       /* jump over whole periods of a steady state to the last generation */
+#define DEFAULT_HISTORY 64  /* fingerprints kept for cycle detection */
+#define CLUSTER_BINS 64     /* cluster size bins (powers of 2) */
+#define QUERY_MAX (1 << 24) /* most cells in a region sent to the query client */
+
+
 /* Messages */
 #define ERROR_ARGV_C "Improper argument count"
 #define ERROR_ARGV_2 "Generation count must be at least 1"
@@ -31,4 +81,17 @@ std::tuple<int,int> get_bounds(int size, int rank, int height);
 #define ERROR_ARGV_7 "Density must be between 0 and 1"
 #define ERROR_ARGV_T "Improper argument types"
 #define ERROR_FILE "An error occurred while accessing the input file."
+#define ERROR_OPTION "Unknown option in .sim file"
+#define ERROR_ENGINE "The selected engine does not support this simulation mode"
+#define ERROR_RADIUS "Radius must be between 1 and the rows of the shortest strip"
+#define ERROR_RASTER "A probability raster is missing or not height x width floats or bytes"
+#define ERROR_TERRAIN "Probability rasters apply to the forest fire (mode 1) only"
+#define ERROR_SOCKET "Could not listen on the service socket"
+#define ERROR_QUERY "Expected: view <row> <col> <rows> <cols> [zoom], watch <row> <col> <rows> <cols> <zoom> <every>, or stop"
+#define ERROR_REGION "The region must lie within the map"
+#define ERROR_JOB "Expected: job <bytes>, then the .sim text, or quit"
+#define ERROR_KERNEL "kernel: table applies to the blocked engine in Conway's Game of Life (mode 2) only"
+#define ERROR_RANKS "Each configuration can run on at most the ranks started"
+#define ERROR_FRAME "Could not open the frame file for writing"
+#define ERROR_FRAME_SIZE "A frame strip must stay under 2 GiB per process; lower frame scale or use more processes"
 #endif //FOREST_DEFS_H
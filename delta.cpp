@@ -0,0 +1,134 @@
+//
+// Change-driven Conway's Game of Life (engine: delta).
+//
+// Each rank keeps the live-neighbor count of every cell of its strip next to the cells.
+// A cell can only change if it or one of its neighbors changed in the last generation,
+// so each generation judges just those cells, and every cell that flips adds or takes one
+// from the counts of its 8 neighbors. Ranks exchange the changes to their edge rows as
+// sparse lists, like the frontier engine, so both the step and the exchange cost follow
+// the number of changes rather than the map area.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+
+/**
+ * Builds the local strip and the neighbor counts; every cell is judged in the first
+ * generation. Halo rows are swapped in full once; after that only changes cross the
+ * strip boundaries. Counts and marks are laid out like the strip's rows with two more
+ * rows above and below, (i + 2) * stride + j + 1 for local row i and column j, so a change
+ * can touch its 8 neighbors without bounds checks; cells off the strip are marked for
+ * good and so never judged.
+ */
+void State::build_delta() {
+    if (_sim->mode() != 2) fail(ERROR_ENGINE);
+    int rows = (int) _nodes->size();
+    _grid = new Grid(rows, _width, 1);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < _width; j++) _grid->set(i, j, get_node_status(i, j));
+    }
+    _depth = 1;
+    transmit_grid();
+
+    int stride = _grid->stride();
+    unsigned long cells = (unsigned long) (rows + 4) * stride;
+    _counts = new vector<unsigned char>(cells, 0);
+    _marked = new vector<unsigned char>(cells, 1);
+    _active = new vector<int>();
+    _flips = new vector<int>();
+    _active->reserve((unsigned long) rows * _width);
+    _flips->reserve((unsigned long) rows * _width);
+    _delta_top = new vector<int>();
+    _delta_bot = new vector<int>();
+    _remote_top = new vector<int>();
+    _remote_bot = new vector<int>();
+    _delta_recv = new vector<int>((unsigned long) _width);
+    for (vector<int>* v : {_delta_top, _delta_bot, _remote_top, _remote_bot}) v->reserve((unsigned long) _width);
+
+    unsigned char* counts = _counts->data();
+    for (int i = 0; i < rows; i++) {
+        unsigned char* up = _grid->row(i - 1);
+        unsigned char* mid = _grid->row(i);
+        unsigned char* down = _grid->row(i + 1);
+        for (int x = 0; x < _width; x++) {
+            int c = (i + 2) * stride + x + 1;
+            counts[c] = (unsigned char) (
+                  (up[x - 1] == 1) + (up[x] == 1) + (up[x + 1] == 1)
+                + (mid[x - 1] == 1) + (mid[x + 1] == 1)
+                + (down[x - 1] == 1) + (down[x] == 1) + (down[x + 1] == 1));
+            _active->push_back(c);
+        }
+    }
+}
+
+
+/**
+ * Adds to the live-neighbor counts of the cells around a cell that changed, and queues
+ * them and the cell itself to be judged next generation
+ * @param c changed cell, in the layout of the counts
+ * @param d +1 if the cell came alive, -1 if it died
+ * @param counts live-neighbor counts
+ * @param marked cells already queued
+ */
+void State::count_change(int c, int d, unsigned char* counts, unsigned char* marked) {
+    int stride = _grid->stride();
+    for (int y = c - stride; y <= c + stride; y += stride) {
+        for (int x = y - 1; x <= y + 1; x++) {
+            if (x != c) counts[x] += (unsigned char) d;
+            if (marked[x] == 0) {
+                marked[x] = 1;
+                _active->push_back(x);
+            }
+        }
+    }
+}
+
+
+/**
+ * Advances the strip one generation: applies the changes received across the strip
+ * edges to the counts, judges the queued cells against the counts, then flips the cells
+ * that change and updates the counts around them
+ */
+void State::step_delta() {
+    Simulator* sim = _sim;
+    int u = (int) get<0>(sim->get_ctrlv()->at(0));
+    int o = (int) get<0>(sim->get_ctrlv()->at(1));
+    int g = (int) get<0>(sim->get_ctrlv()->at(2));
+    int rows = _grid->rows();
+    int stride = _grid->stride();
+    int first = 2 * stride + 1;      /* cell (0, 0) in the layout of the counts */
+    int last = first + (rows - 1) * stride;   /* cell (rows - 1, 0) */
+    unsigned char* counts = _counts->data();
+    unsigned char* marked = _marked->data();
+    unsigned char* cells = _grid->row(0);     /* same layout, from cell (0, 0) */
+
+    for (int c : *_remote_top) count_change(first - stride + c / 4, (c % 4 == 1) ? 1 : -1, counts, marked);
+    for (int c : *_remote_bot) count_change(last + stride + c / 4, (c % 4 == 1) ? 1 : -1, counts, marked);
+
+    _flips->clear();
+    for (int c : *_active) {
+        marked[c] = 0;
+        int pop = counts[c];
+        bool live = cells[c - first] == 1;
+        if (live ? (pop < u || pop > o) : pop == g) _flips->push_back(c);
+    }
+    _judged += _active->size();
+    _flipped += _flips->size();
+    _active->clear();
+
+    _delta_top->clear();
+    _delta_bot->clear();
+    for (int c : *_flips) {
+        int s = 1 - cells[c - first];
+        cells[c - first] = (unsigned char) s;
+        if (c < first + _width) _delta_top->push_back((c - first) * 4 + s);
+        if (c >= last) _delta_bot->push_back((c - last) * 4 + s);
+        count_change(c, s ? 1 : -1, counts, marked);
+    }
+}
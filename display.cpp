@@ -5,14 +5,15 @@
 #include "defs.h"
 #include "State.h"
 #include "Simulator.h"
+#include "Screen.h"
 #include <mpi.h>
-#include <ncurses.h>
+#include <time.h>
 
 using namespace std;
 
 /* Method declarations */
-void display_row(int thread, int row, int width, vector<Node*>* nodev);
-string print_row(int thread, int row, int width, vector<Node*>* nodev);
+void display_row(Screen* screen, Simulator* sim, int thread, int row, int width, vector<Node*>* nodev);
+void print_row(string& out, Simulator* sim, int thread, int row, vector<Node*>* nodev);
 
 ostream& operator << (ostream& o, const Simulator& s);
 string& operator += (string& s, const Simulator& n);
@@ -25,97 +26,120 @@ string& operator += (string& s, const State& n);
 
 
 /**
- * Initialize curses window
+ * Initialize the screen window. Master decides whether the map is shown cell for cell, in
+ * a window sized to the map, or downsampled to the terminal it runs in (viewport);
+ * init_viewport() shares the decision.
  */
 void State::init_window() {
     int w = _width + INFO_W;
     int h = _height + INFO_H;
     _win_width = w;
     _win_height = h;
-    if (_rank == 0) {
-        initscr(); /* start curses */
-        start_color(); /* start color mode */
-        curs_set(0); /* hide cursor */
-        resizeterm(h, w); /* resize curses window */
-        scrollok(stdscr, FALSE); /* disallow scroll */
-        nonl(); /* disallow new lines */
+    if (_rank == 0 && _display) {
+        _screen->open();
+        int lines = _screen->lines(), cols = _screen->cols();
+        _viewport = _view == VIEW_ON || (_view == VIEW_AUTO && (h > lines || w > cols));
+        if (_viewport) {
+            _view_h = max(1, min(_height, lines - INFO_H));
+            _view_w = max(1, min(_width, cols - INFO_W - max(0, (int) to_string(_height).length() - 2)));
+            h = _view_h + INFO_H;
+            w = _view_w + INFO_W;
+        }
+        else _screen->resize(h, w);
     }
+    if (_rank == 0) _out.reserve((unsigned long) (h * (w + INFO_W) + 1024));
 }
 
 /**
- * Resize curses window
+ * Resize screen window
  */
 void State::adjust_window_width(int w) {
     if (w > _win_width) {
         _win_width = w;
     }
-    if (_rank == 0) {
-        resizeterm(_win_height, _win_width);
+    if (_rank == 0 && _display && !_viewport) {
+        _screen->resize(_win_height, _win_width);
     }
 }
 
 /**
  * Displays a live view or snapshot of the current generation, using MPI_Barrier to
  * ensure that no threads are expecting stray messages. All threads send to master,
- * where the data is displayed.
+ * where the data is displayed. Each strip travels as one packed message of states;
+ * colors are derived from the states on master. Headless runs (display: 0) only gather the final
+ * generation. Rows are received into a preallocated row and the text is built in a
+ * reserved buffer, so no generation after the first allocates. Maps larger than the
+ * terminal are drawn by draw_viewport() instead.
  * @param delay
+ * @return text of the displayed generation
  */
-string State::display_map(int delay) {
-    MPI_Barrier(MPI_COMM_WORLD);
-    string out = "";
-    if (_rank != 0) {   /* slave : send map */
-        for (int i = 0; i < _nodes->size(); i++) {
-            int send[_width*2];
-            for (int j = 0; j < _width; j++) send[j] = get_node_status(i, j);
-            for (int j = _width; j < _width*2; j++) send[j] = get_node_color(i, j - _width);
-            MPI_Send(&send,_width*2,MPI_INT,0,0,MPI_COMM_WORLD);
-        }
-    } else {    /* master : receive and display */
-        int row = 1;
-
-        /* Overwrite tiles with spaces */
-        erase();
-
-        /* Row 0 */
-        out += *this;
-        adjust_window_width((int) out.length());
-        mvwaddstr(stdscr,0,0,out.c_str());
-        out += "\n";
-
-        /* Master thread row display */
-        for (int j = 0; j < _nodes->size(); j++) {
-            display_row(0,row,_width, get_row(j)->get_nodev());
-            out += print_row(0,row,_width,get_row(j)->get_nodev()) + "\n";
-            row++;
-        }
+const string& State::display_map(int delay) {
+    if (!_display && _current + _step <= _generations) return _out;
+    if (_engine == ENGINE_SPARSE) sync_sparse();
+    if (_viewport) draw_viewport();
+    else {
+        if (_grid != nullptr) sync_nodes();
+        MPI_Barrier(_comm);
+        _out.clear();
+        if (_rank != 0) {   /* slave : send map */
+            int rows = (int) _nodes->size();
+            if (rows > 0) {
+                for (int i = 0; i < rows; i++) {
+                    for (int j = 0; j < _width; j++) _strip->at((unsigned long) (i * _width + j)) = (unsigned char) get_node_status(i, j);
+                }
+                int bytes = pack_cells(_strip->data(), rows, _width, _wire_top);
+                _wire_raw += (unsigned long) rows * _width * sizeof(int);    /* color no longer shipped */
+                MPI_Send(_wire_top->data(),bytes,MPI_UNSIGNED_CHAR,0,0,_comm);
+            }
+        } else {    /* master : receive and display */
+            int row = 1;
+
+            /* Overwrite tiles with spaces */
+            if (_display) _screen->clear();
+
+            /* Row 0 */
+            _out += *this;
+            if (_display) {
+                adjust_window_width((int) _out.length());
+                _screen->text(0,0,_out.c_str());
+            }
+            _out += "\n";
 
-        /* Slave thread row display */
-        for (int j = 1; j < _height - _nodes->size(); j++) {
-            tuple<int,int> bounds = get_bounds(_size,j,_height);
-            int k = get<1>(bounds) - get<0>(bounds);
-            for (int l = 0; l < k; l++) {
-                int recv[_width*2];
-                MPI_Status status;
-                MPI_Recv(&recv,_width*2,MPI_INT,j,0,MPI_COMM_WORLD,&status);
-                Row* r = new Row(recv,_width);
-                display_row(j,row,_width,r->get_nodev());
-                out += print_row(j,row,_width,r->get_nodev()) + "\n";
+            /* Master thread row display */
+            for (int j = 0; j < _nodes->size(); j++) {
+                if (_display) display_row(_screen,_sim,0,row,_width, get_row(j)->get_nodev());
+                print_row(_out,_sim,0,row,get_row(j)->get_nodev());
                 row++;
             }
-        }
 
-        /* Update tiles */
-        refresh();
+            /* Slave thread row display */
+            for (int j = 1; j < _size; j++) {
+                tuple<int,int> bounds = get_bounds(_size,j,_height);
+                int k = get<1>(bounds) - get<0>(bounds);
+                if (k > 0) recv_cells(_strip->data(), k, _width, j);
+                for (int l = 0; l < k; l++) {
+                    _recv_row->set(_strip->data() + l * _width);
+                    if (_display) display_row(_screen,_sim,j,row,_width,_recv_row->get_nodev());
+                    print_row(_out,_sim,j,row,_recv_row->get_nodev());
+                    row++;
+                }
+            }
+
+            /* Update tiles */
+            if (_display) _screen->show();
 
+        }
     }
 
     /* delay for visibility, 4000000 ns = 25 FPS max */
-    timespec t0, t1;
-    t0.tv_sec = 0;
-    t0.tv_nsec = delay;
-    nanosleep(&t0,&t1);
+    if (_display) {
+        timespec t0, t1;
+        t0.tv_sec = 0;
+        t0.tv_nsec = delay;
+        nanosleep(&t0,&t1);
+    }
 
-    return out;
+    return _out;
 }
 
 
@@ -132,60 +156,163 @@ void Simulator::display() {
 
 /**
  * Body of simulation screen
+ * @param screen screen to draw on
+ * @param sim rules of the simulation (state characters)
  * @param thread origin rank of thread containing nodes to be printed (for display)
  * @param row overall row number (for display)
  * @param intv pointer to a vector containing node values
  */
-void display_row(int thread, int row, int width, vector<Node*>* nodev) {
+void display_row(Screen* screen, Simulator* sim, int thread, int row, int width, vector<Node*>* nodev) {
     string prefix = ((row > 9) ? to_string(row) : ("0" + to_string(row))) + "|";
     int offset = (int) prefix.length();
-    mvaddstr(row,0,prefix.c_str());
-    for (int i = 0; i < nodev->size(); i++) { nodev->at((unsigned long) i)->display(row, i + offset); }
+    screen->text(row,0,prefix.c_str());
+    for (int i = 0; i < nodev->size(); i++) {
+        Node* n = nodev->at((unsigned long) i);
+        n->display(screen, row, i + offset, sim->translate(n->status()));
+    }
     string suffix = "|T"+((thread > 9) ? to_string(thread) : ("0" + to_string(thread)));
-    mvaddstr(row,offset+width,(suffix.c_str()));
+    screen->text(row,offset+width,(suffix.c_str()));
 }
 
-string print_row(int thread, int row, int width, vector<Node*>* nodev) {
-    string out = "";
-    out+= ((row > 9) ? to_string(row) : ("0" + to_string(row))) + "|";
+/**
+ * Appends a plain-text row of the simulation screen
+ * @param out text buffer
+ * @param sim rules of the simulation (state characters)
+ * @param thread origin rank of thread containing nodes to be printed
+ * @param row overall row number
+ * @param nodev pointer to a vector containing the row's nodes
+ */
+void print_row(string& out, Simulator* sim, int thread, int row, vector<Node*>* nodev) {
+    if (row < 10) out += '0';
+    out += to_string(row);
+    out += '|';
     for (int i = 0; i < nodev->size(); i++) {
-        out += Simulator::instance()->translate(nodev->at((unsigned long) i)->status());
+        out += sim->translate(nodev->at((unsigned long) i)->status());
     }
-    out += "|T"+((thread > 9) ? to_string(thread) : ("0" + to_string(thread)));
-    return out;
+    out += "|T";
+    if (thread < 10) out += '0';
+    out += to_string(thread);
+    out += '\n';
 }
 
 /**
  * Display exit message
+ * @param msg message shown under the map before the screen closes
  */
-void State::display_exit(string out) {
-    if (_rank == 0) {
-        curs_set(1);
-        string msg = "Simulation Complete! Press [Enter] to continue.";
+void State::display_exit(const string& msg) {
+    if (_rank == 0 && !_display) cout << _out << endl;
+    if (_rank == 0 && _display) {
         int length = (int) msg.length();
-        attron(COLOR_PAIR(1));
-        mvaddstr(_height + 1, (_width + 10) / 2 - length / 2, msg.c_str());
-        attroff(COLOR_PAIR(1));
-        refresh();
-        getch();
-        getch();
-        endwin();
+        int rows = _viewport ? _view_h : _height;
+        int cols = _viewport ? _view_w : _width;
+        _screen->close(rows + 1, (cols + 10) / 2 - length / 2, msg.c_str());
         cout << "\033[H\033[J";
-        cout << out << endl;
+        cout << _out << endl;
     }
 
 }
 
+/**
+ * Run summary: heap allocations and resident memory up to the end of generation 1
+ * and over the remaining generations (max over ranks), the cell traffic between
+ * ranks against what it would take as MPI_INT (all ranks), the time taken by
+ * halo exchanges, waiting on neighbors included (max over ranks), the time from
+ * setup to the last generation, display included (slowest rank), the cells the delta
+ * engine judged and changed (all ranks), and the steady state found, if any
+ */
+void State::display_summary() {
+    unsigned long allocs[2] = {_alloc_mark, _alloc_end - _alloc_mark};
+    long rss[2] = {_rss_mark, _rss_end};
+    unsigned long wire[2] = {_wire_sent, _wire_raw};
+    unsigned long max_allocs[2];
+    long max_rss[2];
+    unsigned long total_wire[2];
+    double halo[2] = {(_halo_count > 0) ? _halo_time / _halo_count : 0, _halo_max};
+    double max_halo[2];
+    double time = _time_end - _time_start;
+    double max_time;
+    MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, _comm);
+    double max_frame;
+    MPI_Reduce(&_frame_time, &max_frame, 1, MPI_DOUBLE, MPI_MAX, 0, _comm);
+    double max_census;
+    MPI_Reduce(&_census_time, &max_census, 1, MPI_DOUBLE, MPI_MAX, 0, _comm);
+    MPI_Reduce(allocs, max_allocs, 2, MPI_UNSIGNED_LONG, MPI_MAX, 0, _comm);
+    MPI_Reduce(halo, max_halo, 2, MPI_DOUBLE, MPI_MAX, 0, _comm);
+    MPI_Reduce(wire, total_wire, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, _comm);
+    MPI_Reduce(rss, max_rss, 2, MPI_LONG, MPI_MAX, 0, _comm);
+    int tiles[2] = {(_world != nullptr) ? _world->size() : 0, (_world != nullptr) ? _world->peak() : 0};
+    int total_tiles, max_tiles;
+    MPI_Reduce(tiles, &total_tiles, 1, MPI_INT, MPI_SUM, 0, _comm);
+    MPI_Reduce(tiles + 1, &max_tiles, 1, MPI_INT, MPI_MAX, 0, _comm);
+    unsigned long changes[2] = {_judged, _flipped};
+    unsigned long total_changes[2];
+    MPI_Reduce(changes, total_changes, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, _comm);
+    if (_rank == 0) {
+        cout << "Allocations: " << max_allocs[0] << " through generation 1, "
+             << max_allocs[1] << " after" << endl;
+        cout << "Resident:    " << max_rss[0] << " KB after generation 1, "
+             << max_rss[1] << " KB after the last" << endl;
+        cout << "Wire:        " << total_wire[0] << " bytes sent, "
+             << total_wire[1] << " as MPI_INT";
+        if (total_wire[0] > 0) cout << " (" << total_wire[1] / total_wire[0] << "x)";
+        cout << endl;
+        const char* backend[] = {"p2p", "shm", "rma"};
+        cout << "Halo:        " << ((_engine == ENGINE_BLOCKED) ? backend[_halo] : (_engine == ENGINE_SPARSE) ? "all-to-all" : "p2p") << ", "
+             << _halo_count << " exchanges, " << max_halo[0] * 1e6 << " us mean, "
+             << max_halo[1] * 1e6 << " us slowest (max over ranks)" << endl;
+        if (_tuned != TUNE_NONE) {
+            cout << "Tuned:       tile " << _tile << ", depth " << _depth << ", halo " << backend[_halo];
+            if (_tuned == TUNE_CACHED) cout << ", from " << _tune_file << endl;
+            else cout << ", best of " << _tune_trials << " trials in " << _tune_time << " s (not in Time)" << endl;
+        }
+        if (_engine == ENGINE_SPARSE) {
+            cout << "Tiles:       " << total_tiles << " held at the end, at most "
+                 << max_tiles << " on one rank (" << TILE << " x " << TILE << " cells, "
+                 << sizeof(Tile) << " bytes each)" << endl;
+        }
+        if (_clusters > 0) {
+            cout << "Clusters:    " << _census_count << " censuses to " << _cluster_file << ", "
+                 << max_census * 1e3 / max(1L, _census_count) << " ms each (slowest rank)" << endl;
+        }
+        if (!_query_path.empty()) {
+            cout << "Queries:     " << _query_count << " regions sent on " << _query_path << endl;
+        }
+        if (_engine == ENGINE_DELTA) {
+            double stepped = max(1L, (long) _generations - _skipped);
+            cout << "Changes:     " << total_changes[0] / stepped << " cells judged, "
+                 << total_changes[1] / stepped << " changed per generation (of "
+                 << (long) _height * _width << ")" << endl;
+        }
+        if (_frames > 0) {
+            cout << "Frames:      " << _frame_count << " written, " << _frame_bytes / 1e6 << " MB, "
+                 << _frame_bytes / 1e6 / max_frame << " MB/s (slowest rank)" << endl;
+        }
+        cout << "Time:        " << max_time << " s, "
+             << (double) _height * _width * (_generations - _skipped) / max_time << " cell updates/s" << endl;
+        if (_steady != STEADY_OFF) {
+            cout << "Steady:      ";
+            if (_period == 0) cout << "none found";
+            else {
+                cout << "period " << _period << " from generation " << _onset;
+                if (_steady == STEADY_STOP) cout << ", stopped at generation " << _generations;
+                else cout << ", " << _skipped << " generations skipped";
+            }
+            cout << endl;
+        }
+    }
+}
+
+
 /**
  * Display individual node
  *
+ * @param screen screen to draw on
  * @param row Display window row
  * @param col Display window column
+ * @param c character of the node's state
  */
-void Node::display(int row, int col) {
-    attron(COLOR_PAIR(_color));
-    mvaddch(row,col,Simulator::instance()->translate(_state));
-    attroff(COLOR_PAIR(_color));
+void Node::display(Screen* screen, int row, int col, char c) {
+    screen->cell(row,col,c,_color);
 }
 
 
@@ -224,22 +351,22 @@ ostream& operator << (ostream& o, const Simulator& s) {
  * @return
  */
 string& operator += (string& s, const Simulator& n) {
-    string config = "";
-    config += n._name + " | ";
-    for (var v : *n._ctrlv) {
-        config += get<1>(v);
-        config += ": ";
-        config += to_string(get<0>(v));
-        config += " | ";
+    s += n._name;
+    s += " | ";
+    for (const var& v : *n._ctrlv) {
+        s += get<1>(v);
+        s += ": ";
+        s += to_string(get<0>(v));
+        s += " | ";
     }
-    config += "States: ";
+    s += "States: ";
     for (int i = 0; i < n._langv->size(); i++) {
-        config += to_string(i);
-        config += ":[";
-        config += n._langv->at((unsigned long) i);
-        config += "] ";
+        s += to_string(i);
+        s += ":[";
+        s += n._langv->at((unsigned long) i);
+        s += "] ";
     }
-    return s += config;
+    return s;
 }
 
 /**
@@ -254,7 +381,7 @@ ostream& operator << (ostream& o, const State& s) {
     o << s._rank << "| "<< "Start:  " << s._start   << "\tTop:    " << s._top << "\tIgnition:  " << s._ignition << endl;
     o << s._rank << "| "<< "End:    " << s._end     << "\tBot:    " << s._bot << "\tGrowth:    " << s._growth << endl;
     for (int i = 0; i < s._nodes->size(); i++) {
-        o << s._rank << "|  Trees:    \t[ "; for (int j : *s._nodes->at((unsigned long) i)->get_intv()) o << Simulator::instance()->translate(j); o << "]" << endl;
+        o << s._rank << "|  Trees:    \t[ "; for (int j : *s._nodes->at((unsigned long) i)->get_intv()) o << s._sim->translate(j); o << "]" << endl;
     }
     return o;
 }
@@ -266,9 +393,8 @@ ostream& operator << (ostream& o, const State& s) {
  * @return
  */
 string& operator += (string& s, const State& n) {
-    string config = "G: ";
-    config += to_string(n._current);
-    config += " ";
-    config += *Simulator::instance();
-    return s += config;
+    s += "G: ";
+    s += to_string(n._current + n._step - 1);
+    s += " ";
+    return s += *n._sim;
 }
\ No newline at end of file
@@ -0,0 +1,242 @@
+//
+// Frame export (frames: N).
+//
+// Every N generations each rank encodes its own strip with the simulator's palette and
+// all ranks write their strips into one image file with a collective MPI-IO write at
+// offsets computed from the row bounds; nothing passes through master. Master adds the
+// header and the rank holding the last rows the trailer, each with an independent write.
+//
+// ppm / pgm are raw binary netpbm images. png holds the image uncompressed, as stored
+// deflate blocks: each rank writes one IDAT chunk, with its own CRC, and the zlib
+// checksum (Adler-32) of the whole image is combined from per-rank sums.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+#define ADLER_MOD 65521
+#define STORED_MAX 65535     /* bytes per stored deflate block */
+#define PNG_HEAD 33          /* signature and IHDR chunk */
+#define PNG_TAIL 33          /* last IDAT chunk (empty final block, Adler-32) and IEND chunk */
+
+
+/**
+ * @param n bytes of image data
+ * @return bytes n takes as stored deflate blocks
+ */
+static long stored_bytes(long n) {
+    return n + 5 * ((n + STORED_MAX - 1) / STORED_MAX);
+}
+
+
+/**
+ * Writes a 32-bit big-endian number
+ * @param out buffer
+ * @param v value
+ * @return out + 4
+ */
+static unsigned char* put32(unsigned char* out, unsigned long v) {
+    for (int k = 3; k >= 0; k--) *out++ = (unsigned char) (v >> (8 * k));
+    return out;
+}
+
+
+/**
+ * CRC-32 of a byte range, as used by png chunks
+ * @param p first byte
+ * @param n bytes
+ * @return unsigned long
+ */
+static unsigned long crc32(const unsigned char* p, long n) {
+    struct Table {
+        unsigned long t[256];
+        Table() {
+            for (unsigned long k = 0; k < 256; k++) {
+                unsigned long c = k;
+                for (int b = 0; b < 8; b++) c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+                t[k] = c;
+            }
+        }
+    };
+    static const Table table;   /* built once, thread-safe */
+    unsigned long c = 0xffffffffUL;
+    for (long i = 0; i < n; i++) c = table.t[(c ^ p[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffUL;
+}
+
+
+/**
+ * Writes a png chunk around data already in place after its 8-byte head
+ * @param chunk head of the chunk
+ * @param type chunk type
+ * @param n bytes of data
+ * @return end of the chunk
+ */
+static unsigned char* seal_chunk(unsigned char* chunk, const char* type, long n) {
+    put32(chunk, (unsigned long) n);
+    memcpy(chunk + 4, type, 4);
+    return put32(chunk + 8 + n, crc32(chunk + 4, n + 4));
+}
+
+
+/**
+ * Sizes the frame buffers. Each rank writes its strip in one call, so no strip may take
+ * more than INT_MAX bytes; every rank checks the largest strip alike.
+ */
+void State::init_frames() {
+    if (_frames <= 0) return;
+    int ch = (_frame_format == FRAME_PGM) ? 1 : 3;
+    _frame_row = (long) _width * _frame_scale * ch + (_frame_format == FRAME_PNG);
+    long most = (long) (_height / min(_size, _height) + 1) * _frame_scale;   /* rows of the largest strip */
+    if (12 + 2 + stored_bytes(most * _frame_row) > INT_MAX) fail(ERROR_FRAME_SIZE);
+    long rows = (_start < 0) ? 0 : (long) (_end - _start) * _frame_scale;
+    _frame_raw = new vector<unsigned char>((unsigned long) (rows * _frame_row));
+    if (_frame_format == FRAME_PNG) {
+        _frame = new vector<unsigned char>((unsigned long) (12 + 2 + stored_bytes(rows * _frame_row)));
+        _frame_sums = new vector<unsigned long>((unsigned long) (3 * _size));
+    }
+}
+
+
+/**
+ * Encodes the local strip of the current generation, one pixel row per cell row
+ * repeated `frame scale` times
+ */
+void State::encode_frame() {
+    Simulator* sim = _sim;
+    int gray = _frame_format == FRAME_PGM;
+    int s = _frame_scale;
+    unsigned char* out = _frame_raw->data();
+    for (int i = 0; i < _end - _start; i++) {
+        unsigned char* row = out;
+        if (_frame_format == FRAME_PNG) *out++ = 0;    /* filter: none */
+        for (int j = 0; j < _width; j++) {
+            int state = (_grid != nullptr) ? _grid->get(i, j) : get_node_status(i, j);
+            unsigned int c = sim->color(state);
+            unsigned char r = (unsigned char) (c >> 16), g = (unsigned char) (c >> 8), b = (unsigned char) c;
+            for (int k = 0; k < s; k++) {
+                if (gray) *out++ = (unsigned char) ((299 * r + 587 * g + 114 * b) / 1000);
+                else { *out++ = r; *out++ = g; *out++ = b; }
+            }
+        }
+        for (int k = 1; k < s; k++, out += _frame_row) memcpy(out, row, (size_t) _frame_row);
+    }
+}
+
+
+/**
+ * Writes the current generation to <frame file>_<generation>.<format>. Collective.
+ */
+void State::export_frame() {
+    double t = MPI_Wtime();
+    if (_engine == ENGINE_SPARSE) sync_sparse();
+    encode_frame();
+
+    const char* ext[] = {"ppm", "pgm", "png"};
+    char name[4096];
+    snprintf(name, sizeof(name), "%s_%06d.%s", _frame_file.c_str(), _current + _step - 1, ext[_frame_format]);
+    long W = (long) _width * _frame_scale, H = (long) _height * _frame_scale;
+    long first = (_start < 0) ? 0 : (long) _start * _frame_scale;
+    long bytes = (long) _frame_raw->size();
+    const unsigned char* data = _frame_raw->data();
+    int last = min(_size, _height) - 1;   /* rank holding the last rows */
+
+    unsigned char head[64];
+    long head_n;
+    long offset, total;
+    if (_frame_format != FRAME_PNG) {
+        head_n = snprintf((char*) head, sizeof(head), "P%d\n%ld %ld\n255\n", (_frame_format == FRAME_PPM) ? 6 : 5, W, H);
+        offset = head_n + first * _frame_row;
+        total = head_n + H * _frame_row;
+    }
+    else {
+        /* One IDAT chunk of stored blocks per rank; master's starts the zlib stream */
+        unsigned char* chunk = _frame->data();
+        unsigned char* out = chunk + 8;
+        if (_rank == 0) { *out++ = 0x78; *out++ = 0x01; }
+        for (long k = 0; k < bytes; k += STORED_MAX) {
+            long n = min((long) STORED_MAX, bytes - k);
+            *out++ = 0;
+            *out++ = (unsigned char) n; *out++ = (unsigned char) (n >> 8);
+            *out++ = (unsigned char) ~n; *out++ = (unsigned char) (~n >> 8);
+            memcpy(out, data + k, (size_t) n);
+            out += n;
+        }
+        long n = out - chunk - 8;
+        data = chunk;
+        bytes = (n > 0) ? seal_chunk(chunk, "IDAT", n) - chunk : 0;
+
+        long before = 0;
+        MPI_Exscan(&bytes, &before, 1, MPI_LONG, MPI_SUM, _comm);
+        if (_rank == 0) before = 0;
+        MPI_Allreduce(&bytes, &total, 1, MPI_LONG, MPI_SUM, _comm);
+        offset = PNG_HEAD + before;
+        total += PNG_HEAD + PNG_TAIL;
+
+        /* Adler-32 sums of the strip, combined in row order by the last rank */
+        unsigned long a = 0, b = 0;
+        const unsigned char* raw = _frame_raw->data();
+        long size = (long) _frame_raw->size();
+        for (long k = 0; k < size; ) {
+            long end = min(size, k + 5552);
+            for (; k < end; k++) { a += raw[k]; b += a; }
+            a %= ADLER_MOD;
+            b %= ADLER_MOD;
+        }
+        unsigned long sums[3] = {a, b, (unsigned long) size};
+        MPI_Gather(sums, 3, MPI_UNSIGNED_LONG, _frame_sums->data(), 3, MPI_UNSIGNED_LONG, last, _comm);
+
+        head_n = 0;
+        if (_rank == 0) {
+            static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            memcpy(head, signature, 8);
+            unsigned char* p = put32(head + 16, (unsigned long) W);
+            p = put32(p, (unsigned long) H);
+            *p++ = 8;    /* bit depth */
+            *p++ = 2;    /* RGB */
+            *p++ = 0; *p++ = 0; *p++ = 0;
+            seal_chunk(head + 8, "IHDR", 13);
+            head_n = PNG_HEAD;
+        }
+    }
+
+    MPI_File file;
+    int failed = MPI_File_open(_comm, name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS;
+    int any;
+    MPI_Allreduce(&failed, &any, 1, MPI_INT, MPI_MAX, _comm);
+    if (any) {
+        if (!failed) MPI_File_close(&file);
+        fail(ERROR_FRAME);
+    }
+    MPI_File_set_size(file, (MPI_Offset) total);
+    if (_rank == 0) MPI_File_write_at(file, 0, head, (int) head_n, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, (MPI_Offset) offset, data, (int) bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    if (_frame_format == FRAME_PNG && _rank == last) {
+        unsigned long a = 1, b = 0;
+        for (int r = 0; r < _size; r++) {
+            const unsigned long* s = _frame_sums->data() + 3 * r;
+            b = (b + s[1] + (s[2] % ADLER_MOD) * a) % ADLER_MOD;
+            a = (a + s[0]) % ADLER_MOD;
+        }
+        unsigned char tail[PNG_TAIL];
+        unsigned char* p = tail + 8;
+        *p++ = 1; *p++ = 0; *p++ = 0; *p++ = 0xff; *p++ = 0xff;   /* empty final block */
+        put32(p, (b << 16) | a);
+        p = seal_chunk(tail, "IDAT", 9);
+        seal_chunk(p, "IEND", 0);
+        MPI_File_write_at(file, (MPI_Offset) (total - PNG_TAIL), tail, PNG_TAIL, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&file);
+
+    _frame_count++;
+    _frame_bytes += (unsigned long) total;
+    _frame_time += MPI_Wtime() - t;
+}
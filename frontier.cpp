@@ -0,0 +1,190 @@
+//
+// Frontier-driven forest fire (engine: frontier).
+//
+// Each rank keeps the list of its burning cells. Spread is computed only from that list,
+// and the cells it lists burn out as it turns over, so the cost of fire propagation follows
+// the fire front rather than the map area. Lightning and regrowth come from the event
+// samplers. Instead of full halo rows, ranks exchange the sparse list of cells that changed
+// in their edge rows; the changes that set a cell burning double as the remote frontier.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+#include "Sampler.h"
+
+using namespace std;
+
+
+/**
+ * Builds the local strip, its frontier and the change lists. Halo rows are swapped in
+ * full once; after that only changes cross the strip boundaries.
+ */
+void State::build_frontier() {
+    if (_sim->mode() != 1) fail(ERROR_ENGINE);
+    int rows = (int) _nodes->size();
+    unsigned long cells = (unsigned long) rows * _width;
+    _grid = new Grid(rows, _width, 1);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < _width; j++) _grid->set(i, j, get_node_status(i, j));
+    }
+    _depth = 1;
+    transmit_grid();
+
+    _frontier = new vector<int>();
+    _ignite = new vector<int>();
+    _grow = new vector<int>();
+    _frontier->reserve(cells);
+    _ignite->reserve(cells);
+    _grow->reserve(cells);
+    _delta_top = new vector<int>();
+    _delta_bot = new vector<int>();
+    _remote_top = new vector<int>();
+    _remote_bot = new vector<int>();
+    _delta_recv = new vector<int>((unsigned long) _width);
+    for (vector<int>* v : {_delta_top, _delta_bot, _remote_top, _remote_bot}) v->reserve((unsigned long) _width);
+
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < _width; j++) if (_grid->get(i, j) == 2) _frontier->push_back(i * _width + j);
+    }
+    for (int j = 0; j < _width; j++) {
+        if (_top > -1 && _grid->get(-1, j) == 2) _remote_top->push_back(j * 4 + 2);
+        if (_bot > -1 && _grid->get(rows, j) == 2) _remote_bot->push_back(j * 4 + 2);
+    }
+}
+
+
+/**
+ * Receives one edge change list into a halo row, and keeps the changes (column * 4 +
+ * state) for the next generation: those that set a cell burning are the remote frontier.
+ * @param source neighbor rank
+ * @param row halo row
+ * @param remote changes to that halo row
+ */
+void State::receive_changes(int source, int row, vector<int>* remote) {
+    MPI_Status status;
+    int count;
+    MPI_Recv(_delta_recv->data(),_width,MPI_INT,source,0,_comm,&status);
+    MPI_Get_count(&status, MPI_INT, &count);
+    remote->clear();
+    unsigned char* r = _grid->row(row);
+    for (int k = 0; k < count; k++) {
+        int j = _delta_recv->at((unsigned long) k) / 4;
+        int s = _delta_recv->at((unsigned long) k) % 4;
+        r[j] = (unsigned char) s;
+        remote->push_back(_delta_recv->at((unsigned long) k));
+    }
+}
+
+
+/**
+ * Send / receive the changes made to the edge rows in the last generation. Blocks on receive.
+ */
+void State::transmit_frontier() {
+    MPI_Request requests[2];
+    int n = 0;
+    if (_top > -1) MPI_Isend(_delta_top->data(),(int) _delta_top->size(),MPI_INT,_top,0,_comm,&requests[n++]);
+    if (_bot > -1) MPI_Isend(_delta_bot->data(),(int) _delta_bot->size(),MPI_INT,_bot,0,_comm,&requests[n++]);
+
+    if (_top > -1) receive_changes(_top, -1, _remote_top);
+    if (_bot > -1) receive_changes(_bot, _grid->rows(), _remote_bot);
+    MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+}
+
+
+/**
+ * Sets a cell and records the change if it lies on an edge row
+ * @param i local row
+ * @param j column
+ * @param s status
+ */
+void State::change_cell(int i, int j, int s) {
+    _grid->set(i, j, s);
+    if (i == 0) _delta_top->push_back(j * 4 + s);
+    if (i == _grid->rows() - 1) _delta_bot->push_back(j * 4 + s);
+}
+
+
+/**
+ * Sets a tree burning and adds it to the next frontier
+ * @param i local row
+ * @param j column
+ */
+void State::ignite_cell(int i, int j) {
+    change_cell(i, j, 2);
+    _ignite->push_back(i * _width + j);
+}
+
+
+/**
+ * Advances the forest one generation. Regrowth is judged first, on this generation's
+ * trees; spread and lightning then set trees burning in place, which also keeps a tree
+ * from being claimed twice; finally the old frontier burns out and the new trees grow.
+ */
+void State::step_frontier() {
+    Simulator* sim = _sim;
+    double g = get<0>(sim->get_ctrlv()->at(1));
+    const Raster* ignition = sim->ignition_map();
+    const Raster* growth_map = sim->growth_map();
+    Sampler lightning(_seed, STREAM_LIGHTNING, sim->lightning_rate());
+    Sampler growth(_seed, STREAM_GROWTH, sim->growth_rate());
+    unsigned long accept = stream_seed(_seed, STREAM_ACCEPT);
+    unsigned long strike = stream_seed(_seed, STREAM_STRIKE);
+    int rows = _grid->rows();
+    long gen = _current;
+
+    _ignite->clear();
+    _grow->clear();
+    _delta_top->clear();
+    _delta_bot->clear();
+
+    /* Regrowth */
+    for (int i = 0; i < rows; i++) {
+        unsigned char* up = _grid->row(i - 1);
+        unsigned char* mid = _grid->row(i);
+        unsigned char* down = _grid->row(i + 1);
+        for (growth.seek(gen, _start + i, 0, _width); growth.next() < _width; growth.advance()) {
+            int x = (int) growth.next();
+            if (mid[x] != 0) continue;
+            int trees = (up[x - 1] == 1) + (up[x] == 1) + (up[x + 1] == 1)
+                      + (mid[x - 1] == 1) + (mid[x + 1] == 1)
+                      + (down[x - 1] == 1) + (down[x] == 1) + (down[x + 1] == 1);
+            double p = min(1.0, ((growth_map == nullptr) ? g : growth_map->at(_start + i, x)) * (trees + 1));
+            if (toss_at(accept, gen, _start + i, x) * growth.p() < p) _grow->push_back(i * _width + x);
+        }
+    }
+
+    /* Spread from the local frontier and from burning cells across the strip edges */
+    for (int c : *_frontier) {
+        int i = c / _width, j = c % _width;
+        for (int y = max(0, i - 1); y <= min(rows - 1, i + 1); y++) {
+            unsigned char* r = _grid->row(y);
+            for (int x = j - 1; x <= j + 1; x++) if (r[x] == 1) ignite_cell(y, x);
+        }
+    }
+    for (int c : *_remote_top) {
+        if (c % 4 != 2) continue;
+        for (int x = c / 4 - 1; x <= c / 4 + 1; x++) if (_grid->get(0, x) == 1) ignite_cell(0, x);
+    }
+    for (int c : *_remote_bot) {
+        if (c % 4 != 2) continue;
+        for (int x = c / 4 - 1; x <= c / 4 + 1; x++) if (_grid->get(rows - 1, x) == 1) ignite_cell(rows - 1, x);
+    }
+
+    /* Lightning on trees that did not catch */
+    for (int i = 0; i < rows; i++) {
+        unsigned char* r = _grid->row(i);
+        for (lightning.seek(gen, _start + i, 0, _width); lightning.next() < _width; lightning.advance()) {
+            int x = (int) lightning.next();
+            if (r[x] != 1) continue;
+            if (ignition == nullptr || toss_at(strike, gen, _start + i, x) * lightning.p() < ignition->at(_start + i, x)) ignite_cell(i, x);
+        }
+    }
+
+    /* Burn out and regrow */
+    for (int c : *_frontier) change_cell(c / _width, c % _width, 0);
+    for (int c : *_grow) change_cell(c / _width, c % _width, 1);
+    swap(_frontier, _ignite);
+}
@@ -0,0 +1,127 @@
+//
+// Halo exchange backends for the grid engines besides packed point-to-point (halo: p2p).
+//
+// halo: shm - ranks on the same node keep their strips in one MPI-3 shared window. A
+// strip is linked to the strips of its neighbors on the node, so their edge rows are read
+// in place and no halo rows are copied or sent between them. Each block only needs a
+// handshake with those neighbors: every rank has finished the last block (its rows are
+// complete and it is done reading ours) before any rank writes the buffer the last block
+// read. Neighbors on other nodes still exchange packed rows point-to-point.
+//
+// halo: rma - every rank exposes its strip in an RMA window and neighbors MPI_Put their
+// edge rows straight into its halo rows. Synchronization is post-start-complete-wait
+// restricted to the neighbors, so no rank waits in a matching receive.
+//
+
+#include <mpi.h>
+#include <cstring>
+#include "defs.h"
+#include "State.h"
+
+using namespace std;
+
+
+/**
+ * Allocates the local strip in the node's shared window and links it to the strips of
+ * the neighbors on the same node
+ * @param rows local rows
+ * @return Grid object
+ */
+Grid* State::share_grid(int rows) {
+    unsigned long bytes = Grid::bytes(rows, _width, _depth * _radius);
+    unsigned char* base;
+    MPI_Comm_split_type(_comm, MPI_COMM_TYPE_SHARED, _rank, MPI_INFO_NULL, &_shm_comm);
+    MPI_Win_allocate_shared((MPI_Aint) bytes, 1, MPI_INFO_NULL, _shm_comm, &base, &_shm_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, _shm_win);
+    memset(base, OUT_OF_BOUNDS, bytes);
+
+    Grid* grid = new Grid(rows, _width, _depth * _radius, base);
+    Grid* above = (_top > -1) ? shared_grid(_top) : nullptr;
+    Grid* below = (_bot > -1) ? shared_grid(_bot) : nullptr;
+    _shm_top = above != nullptr;
+    _shm_bot = below != nullptr;
+    grid->link(above, below);
+    return grid;
+}
+
+
+/**
+ * Maps the strip of another rank, if it shares this node
+ * @param rank rank in the simulation's communicator
+ * @return Grid object over the rank's window segment, or nullptr
+ */
+Grid* State::shared_grid(int rank) {
+    MPI_Group all, node;
+    int local;
+    MPI_Comm_group(_comm, &all);
+    MPI_Comm_group(_shm_comm, &node);
+    MPI_Group_translate_ranks(all, 1, &rank, node, &local);
+    MPI_Group_free(&all);
+    MPI_Group_free(&node);
+    if (local == MPI_UNDEFINED) return nullptr;
+
+    MPI_Aint size;
+    int unit;
+    unsigned char* base;
+    MPI_Win_shared_query(_shm_win, local, &size, &unit, &base);
+    tuple<int,int> bounds = get_bounds(_size, rank, _height);
+    return new Grid(get<1>(bounds) - get<0>(bounds), _width, _depth * _radius, base);
+}
+
+
+/**
+ * Exposes the local strip to its neighbors in an RMA window
+ */
+void State::expose_grid() {
+    unsigned long bytes = Grid::bytes(_grid->rows(), _width, _grid->halo());
+    MPI_Win_create(_grid->cells(), (MPI_Aint) bytes, 1, MPI_INFO_NULL, _comm, &_rma_win);
+
+    int neighbors[2];
+    int n = 0;
+    if (_top > -1) neighbors[n++] = _top;
+    if (_bot > -1) neighbors[n++] = _bot;
+    MPI_Group all;
+    MPI_Comm_group(_comm, &all);
+    MPI_Group_incl(all, n, neighbors, &_rma_group);
+    MPI_Group_free(&all);
+    _rma = true;
+}
+
+
+/**
+ * Offset of the halo rows the next block needs in a neighbor's window. Strips step in
+ * lockstep, so the neighbor's current generation is in the same half as ours.
+ * @param rank neighbor rank
+ * @param below the rows under the neighbor's strip (otherwise those above it)
+ * @return displacement in cells
+ */
+MPI_Aint State::rma_offset(int rank, bool below) {
+    tuple<int,int> bounds = get_bounds(_size, rank, _height);
+    int rows = get<1>(bounds) - get<0>(bounds);
+    int halo = _grid->halo();
+    int i = below ? rows : -_step * _radius;
+    return (MPI_Aint) (_grid->generation() * Grid::bytes(rows, _width, halo) / 2)
+         + (MPI_Aint) (i + halo) * _grid->stride();
+}
+
+
+/**
+ * Puts as many border rows as the next block will reach into the neighbors' halo
+ * rows. Returns once the neighbors' rows have arrived.
+ */
+void State::transmit_rma() {
+    int rows = _grid->rows();
+    int halo = _grid->halo();
+    int n = _step * _radius;
+    int count = n * _grid->stride();
+    MPI_Win_post(_rma_group, 0, _rma_win);
+    MPI_Win_start(_rma_group, 0, _rma_win);
+    if (_top > -1) MPI_Put(_grid->row(0) - halo,count,MPI_UNSIGNED_CHAR,_top,rma_offset(_top, true),count,MPI_UNSIGNED_CHAR,_rma_win);
+    if (_bot > -1) MPI_Put(_grid->row(rows - n) - halo,count,MPI_UNSIGNED_CHAR,_bot,rma_offset(_bot, false),count,MPI_UNSIGNED_CHAR,_rma_win);
+    MPI_Win_complete(_rma_win);
+    MPI_Win_wait(_rma_win);
+
+    int sent = (_top > -1) + (_bot > -1);
+    _wire_sent += (unsigned long) (sent * count);
+    _wire_raw += (unsigned long) (sent * n * _width) * sizeof(int);
+}
@@ -1,8 +1,14 @@
-
 #include "defs.h"
 #include "State.h"
 #include "Simulator.h"
+#include "Service.h"
+#include "Verifier.h"
+#ifndef FOREST_NO_CURSES
+#include "Curses.h"
+#endif
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -10,24 +16,74 @@ using namespace std;
 
 
 int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
 
     /* thread state */
-    State* s = new State(argc, argv);
+    State* s;
+    try {
+        if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
+            Service* service = new Service(argv[2], MPI_COMM_WORLD);
+            service->run();
+            delete service;
+            quit();
+        }
+        if ((argc == 4 || argc == 6) && strcmp(argv[1], "--verify") == 0) {
+            Verifier* verifier = new Verifier(argv[2], argv[3], (argc == 6) ? stoi(argv[4]) : 0,
+                                              (argc == 6) ? stoi(argv[5]) : 0, MPI_COMM_WORLD);
+            bool match = verifier->run();
+            delete verifier;
+            quit(match ? 0 : 1);
+        }
+#ifdef FOREST_NO_CURSES
+        s = new State(argc, argv, MPI_COMM_WORLD, nullptr);   /* headless build */
+#else
+        s = new State(argc, argv, MPI_COMM_WORLD, new Curses());
+#endif
+    } catch (exception& e) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if (rank == 0) {
+            cout << e.what() << endl << "Usage:" << endl;
+            cout << "Mode 1: ./forest [filename] [# generations] [ignition probability] [growth probability]" << endl;
+            cout << "Mode 2: ./forest [.sim filename]" << endl;
+            cout << "Service: ./forest --serve [socket path]" << endl;
+            cout << "Verify: ./forest --verify [.sim filename] [.sim filename] [ranks] [ranks]" << endl;
+        }
+        quit();
+    }
 
     /* run simulation */ /* State.cpp contains detailed flow */
-    string out;
-    for (int i = 0; i < s->get_current_generation(); i++) {
-        s->transmit_nodes();
-        s->update_neighbors();
-        s->apply_simulation();
-        out = s->display_map(SCREEN_DELAY);
-        s->inc_n();
+    try {
+        while (s->running()) {
+            s->transmit_nodes();
+            s->update_neighbors();
+            s->apply_simulation();
+            s->display_map(SCREEN_DELAY);
+            s->inc_n();
+        }
+    } catch (exception& e) {   /* every rank fails together, e.g. an unwritable frame file */
+        s->display_exit(string(e.what()) + " Press [Enter] to continue.");
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if (rank == 0) cout << e.what() << endl;
+        quit(1);
     }
 
     /* end simulation */
-    s->display_exit(out);
+    s->display_exit();
+    s->display_summary();
+    delete s;
 
     /* exit */
     quit();
 }
 
+
+/**
+ * Finalize MPI
+ * @param status exit status
+ */
+void quit(int status) {
+    MPI_Finalize();
+    exit(status);
+}
@@ -0,0 +1,23 @@
+//
+// Global operator new / delete of the forest binary, counted for the run summary.
+// Not part of the library, which leaves the allocator of embedding programs alone.
+//
+
+#include <cstdlib>
+#include <new>
+#include "defs.h"
+
+using namespace std;
+
+
+void* operator new(size_t n) {
+    alloc_note(n);
+    void* p = malloc(n ? n : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
@@ -0,0 +1,274 @@
+//
+// Region queries (query: <socket path>).
+//
+// A rectangle of the map is read from the ranks whose strips hold it, found with
+// get_bounds(), and nobody else: at full resolution each owner sends its rows of the
+// rectangle straight out of its cells with a strided MPI datatype, and master receives
+// them straight into the result, so no side packs or copies the rows. Zoomed out, every
+// result cell stands for a zoom x zoom block; owners send state counts per block and
+// master adds the blocks that straddle two strips and picks one state per block, as the
+// viewport does. Either way the traffic follows the size of the result, not of the map.
+//
+// Master listens on a Unix socket and polls it once per step without blocking. A client
+// sends lines
+//
+//     view <row> <col> <rows> <cols> [zoom]            the next generation, once
+//     watch <row> <col> <rows> <cols> <zoom> <every>   every <every> generations
+//     stop
+//
+// and receives `region <generation> <row> <col> <rows> <cols> <zoom>` (the rectangle
+// clipped to the map, in result cells) followed by rows x cols bytes of states, or
+// `error <message>`. Panning and zooming is a new watch.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "defs.h"
+#include "State.h"
+
+using namespace std;
+
+#define QUERY_TAG 3    /* message tag of region rows and counts */
+
+
+/**
+ * Master listens on the query socket, without blocking. Collective.
+ */
+void State::init_query() {
+    _query_counts = new vector<int>();
+    _query_sum = new vector<int>();
+    _query_out = new vector<unsigned char>();
+    _query_requests = new vector<MPI_Request>((unsigned long) ((_rank == 0) ? _size : 0));
+    if (_query_path.empty()) return;
+    int ok = 1;
+    if (_rank == 0) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        ok = _query_path.size() < sizeof(addr.sun_path);
+        if (ok) {
+            _query_path.copy(addr.sun_path, _query_path.size());
+            unlink(_query_path.c_str());
+            _query_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+            ok = _query_listen >= 0 && bind(_query_listen, (sockaddr*) &addr, sizeof(addr)) == 0 && listen(_query_listen, 4) == 0;
+        }
+        if (ok) fcntl(_query_listen, F_SETFL, O_NONBLOCK);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, _comm);
+    if (!ok) fail(ERROR_SOCKET);
+}
+
+
+/**
+ * Clips a rectangle to the map
+ * @param q row, column, rows, columns and zoom, updated
+ * @param height map height
+ * @param width map width
+ * @return false if nothing is left
+ */
+static bool clip(int* q, int height, int width) {
+    int row = max(0, q[0]), col = max(0, q[1]);
+    q[2] = min(q[0] + q[2], height) - row;
+    q[3] = min(q[1] + q[3], width) - col;
+    q[0] = row;
+    q[1] = col;
+    q[4] = max(1, q[4]);
+    return q[2] > 0 && q[3] > 0;
+}
+
+
+/**
+ * Sends a line to the query client, dropping the client if it is gone (master)
+ * @param head line without its newline
+ * @param body bytes that follow the line
+ * @param n bytes of body
+ */
+void State::query_reply(const string& head, const unsigned char* body, long n) {
+    if (_query_conn < 0) return;
+    string line = head + "\n";
+    iovec parts[2] = {{(void*) line.data(), line.size()}, {(void*) body, (size_t) n}};
+    msghdr msg = {};
+    msg.msg_iov = parts;
+    msg.msg_iovlen = (n > 0) ? 2 : 1;
+    long total = (long) line.size() + n;
+    while (total > 0) {   /* blocking: the run waits for a slow client */
+        long k = sendmsg(_query_conn, &msg, MSG_NOSIGNAL);
+        if (k <= 0) {
+            close(_query_conn);
+            _query_conn = -1;
+            _query[2] = 0;
+            return;
+        }
+        total -= k;
+        while (msg.msg_iovlen > 0 && (size_t) k >= msg.msg_iov[0].iov_len) {
+            k -= (long) msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (char*) msg.msg_iov[0].iov_base + k;
+            msg.msg_iov[0].iov_len -= (size_t) k;
+        }
+    }
+}
+
+
+/**
+ * Reads the commands the client has sent so far, without blocking (master)
+ */
+void State::poll_query() {
+    if (_query_conn < 0) {
+        _query_conn = accept(_query_listen, nullptr, nullptr);
+        _query_in.clear();
+        if (_query_conn < 0) return;
+    }
+    char buf[4096];
+    long n;
+    while ((n = recv(_query_conn, buf, sizeof(buf), MSG_DONTWAIT)) > 0) _query_in.append(buf, (unsigned long) n);
+    if (n == 0) {   /* hung up */
+        close(_query_conn);
+        _query_conn = -1;
+        _query[2] = 0;
+        return;
+    }
+
+    unsigned long end;
+    while ((end = _query_in.find('\n')) != string::npos) {
+        istringstream words(_query_in.substr(0, end));
+        _query_in.erase(0, end + 1);
+        string verb;
+        words >> verb;
+        if (verb == "stop") { _query[2] = 0; continue; }
+        int q[6] = {0, 0, 0, 0, 1, 0};
+        bool ok = (verb == "view" || verb == "watch") && (words >> q[0] >> q[1] >> q[2] >> q[3]);
+        if (ok && verb == "view") words >> q[4];
+        if (ok && verb == "watch") ok = (words >> q[4] >> q[5]) && q[5] > 0;
+        ok = ok && clip(q, _height, _width);
+        if (ok && (long) ((q[2] + q[4] - 1) / q[4]) * ((q[3] + q[4] - 1) / q[4]) > QUERY_MAX) ok = false;
+        if (!ok) { query_reply(string("error ") + ERROR_QUERY, nullptr, 0); continue; }
+        copy(q, q + 6, _query);
+    }
+}
+
+
+/**
+ * Reads a rectangle of the current generation. Collective; only the ranks holding rows
+ * of the rectangle send anything.
+ * @param q row, column, rows, columns and zoom, clipped to the map
+ * @param out result, ceil(rows / zoom) x ceil(columns / zoom) states (master)
+ */
+void State::region(const int* q, unsigned char* out) {
+    int y = q[0], x = q[1], h = q[2], w = q[3], z = q[4];
+    int ow = (w + z - 1) / z;
+    if (_engine == ENGINE_SPARSE) sync_sparse();
+
+    /* Rows of the rectangle in the local strip */
+    int lo = (_start < 0) ? 0 : max(y, _start);
+    int hi = (_start < 0) ? 0 : min(y + h, _end);
+    const unsigned char* src = nullptr;
+    int stride = _width;
+    if (lo < hi && _grid != nullptr) {
+        src = _grid->row(lo - _start) + x;
+        stride = _grid->stride();
+    }
+    else if (lo < hi) {
+        for (int i = lo; i < hi && _engine != ENGINE_SPARSE; i++) {   /* sparse: synced whole */
+            unsigned char* r = _strip->data() + (i - _start) * _width;
+            for (int j = x; j < x + w; j++) r[j] = (unsigned char) get_node_status(i - _start, j);
+        }
+        src = _strip->data() + (lo - _start) * _width + x;
+    }
+
+    if (z == 1) {
+        if (_rank == 0) {
+            MPI_Request* requests = _query_requests->data();
+            int n = 0;
+            for (int r = 1; r < _size; r++) {
+                tuple<int,int> bounds = get_bounds(_size, r, _height);
+                int a = max(y, get<0>(bounds)), b = min(y + h, get<1>(bounds));
+                if (a < b) MPI_Irecv(out + (long) (a - y) * w,(b - a) * w,MPI_UNSIGNED_CHAR,r,QUERY_TAG,_comm,&requests[n++]);
+            }
+            for (int i = lo; i < hi; i++) memcpy(out + (long) (i - y) * w, src + (long) (i - lo) * stride, (size_t) w);
+            MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+        }
+        else if (lo < hi) {
+            int shape[3] = {hi - lo, w, stride};
+            if (!equal(shape, shape + 3, _query_shape)) {
+                if (_query_shape[0] > 0) MPI_Type_free(&_query_type);
+                MPI_Type_vector(shape[0], shape[1], shape[2], MPI_UNSIGNED_CHAR, &_query_type);
+                MPI_Type_commit(&_query_type);
+                copy(shape, shape + 3, _query_shape);
+            }
+            MPI_Send(src,1,_query_type,0,QUERY_TAG,_comm);
+        }
+        return;
+    }
+
+    /* Zoomed out: state counts per block of the result rows the strip touches */
+    int first = (lo < hi) ? (lo - y) / z : 0;
+    int rows = (lo < hi) ? (hi - 1 - y) / z - first + 1 : 0;
+    _query_counts->assign((unsigned long) (rows * ow * VIEW_STATES), 0);
+    int* counts = _query_counts->data();
+    for (int i = lo; i < hi; i++) {
+        const unsigned char* r = src + (long) (i - lo) * stride;
+        int* c = counts + ((i - y) / z - first) * ow * VIEW_STATES;
+        for (int j = 0; j < w; j++) c[(j / z) * VIEW_STATES + r[j]]++;
+    }
+    if (_rank != 0) {
+        if (rows > 0) MPI_Send(counts,(int) _query_counts->size(),MPI_INT,0,QUERY_TAG,_comm);
+        return;
+    }
+
+    int oh = (h + z - 1) / z;
+    _query_sum->assign((unsigned long) (oh * ow * VIEW_STATES), 0);
+    int* sum = _query_sum->data();
+    for (int r = 0; r < _size; r++) {
+        tuple<int,int> bounds = get_bounds(_size, r, _height);
+        int a = max(y, get<0>(bounds)), b = min(y + h, get<1>(bounds));
+        if (get<0>(bounds) < 0 || a >= b) continue;
+        int from = (a - y) / z;
+        int n = ((b - 1 - y) / z - from + 1) * ow * VIEW_STATES;
+        if (r != 0) {
+            _query_counts->resize((unsigned long) n);
+            MPI_Recv(_query_counts->data(),n,MPI_INT,r,QUERY_TAG,_comm,MPI_STATUS_IGNORE);
+        }
+        const int* c = _query_counts->data();
+        for (int k = 0; k < n; k++) sum[from * ow * VIEW_STATES + k] += c[k];
+    }
+    for (int c = 0; c < oh * ow; c++) out[c] = (unsigned char) reduce_block(sum + c * VIEW_STATES);
+}
+
+
+/**
+ * Answers the query client after a step: master reads its commands and, when the
+ * watched region is due, every rank takes part in reading it. Collective.
+ */
+void State::serve_query() {
+    int gen = _current + _step - 1;
+    int q[5] = {0, 0, 0, 0, 1};
+    if (_rank == 0) {
+        poll_query();
+        int every = _query[5];
+        bool due = _query[2] > 0 && (every == 0 || gen / every > (gen - _step) / every);
+        if (due) copy(_query, _query + 5, q);
+        if (due && every == 0) _query[2] = 0;   /* view: once */
+    }
+    MPI_Bcast(q, 5, MPI_INT, 0, _comm);
+    if (q[2] == 0) return;
+
+    int oh = (q[2] + q[4] - 1) / q[4], ow = (q[3] + q[4] - 1) / q[4];
+    if (_rank == 0) _query_out->resize((unsigned long) (oh * ow));
+    region(q, (_rank == 0) ? _query_out->data() : nullptr);
+    if (_rank == 0) {
+        ostringstream head;
+        head << "region " << gen << " " << q[0] << " " << q[1] << " " << oh << " " << ow << " " << q[4];
+        query_reply(head.str(), _query_out->data(), (long) _query_out->size());
+        _query_count++;
+    }
+}
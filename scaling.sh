@@ -0,0 +1,70 @@
+#!/bin/bash
+#
+# Strong and weak scaling series of the forest binary on localhost, as CSV.
+#
+#     [MPIRUN=mpiexec] ./scaling.sh [max ranks] [engine] [generations] > scaling.csv
+#
+# Strong scaling runs the standard map sizes at -np 1..N. Weak scaling gives every rank
+# the same number of rows, so the map grows with -np. Runs are headless with a fixed
+# seed; times are the "Time:" line of the run summary (setup to last generation,
+# slowest rank). Efficiency is t1 / (np * tnp) for strong and t1 / tnp for weak scaling.
+#
+
+MAX=${1:-$(nproc)}
+ENGINE=${2:-blocked}
+GENERATIONS=${3:-100}
+SIZES="50x150 256x256 1024x1024"    # strong scaling maps (height x width)
+WEAK_ROWS=128                        # rows per rank, weak scaling
+WEAK_WIDTH=1024
+FOREST=$(dirname "$0")/forest
+MPIRUN=${MPIRUN:-"mpirun --allow-run-as-root --oversubscribe"}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# write_sim file mode height width
+write_sim() {
+    {
+        printf 'mode:\n%d\nheight:\n%d\nwidth:\n%d\ngenerations:\n%d\n' "$2" "$3" "$4" "$GENERATIONS"
+        if [ "$2" = 1 ]; then printf 'ignition:\n0.0001\ngrowth:\n0.01\ninit density:\n0.6\n'
+        else printf 'underpopulation:\n2\noverpopulation:\n3\ngrowth:\n3\ninit density:\n0.3\n'; fi
+        printf 'seed:\n1\ndisplay:\n0\nengine:\n%s\n' "$ENGINE"
+    } > "$1"
+}
+
+# run np file -> seconds
+run() {
+    $MPIRUN -np "$1" "$FOREST" "$2" | awk '/^Time:/ { print $2 }'
+}
+
+# row series mode np height width seconds t1
+row() {
+    awk -v s="$1" -v m="$2" -v e="$ENGINE" -v p="$3" -v h="$4" -v w="$5" -v g="$GENERATIONS" -v t="$6" -v t1="$7" 'BEGIN {
+        eff = (s == "strong") ? t1 / (p * t) : t1 / t
+        printf "%s,%s,%s,%d,%d,%d,%d,%.6f,%.0f,%.3f\n", s, (m == 1) ? "forest" : "conway", e, p, h, w, g, t, h * w * g / t, eff
+    }'
+}
+
+echo "series,mode,engine,np,height,width,generations,seconds,cell_updates_per_s,efficiency"
+for mode in 1 2; do
+    [ "$ENGINE" = frontier ] && [ "$mode" = 2 ] && continue
+    for size in $SIZES; do
+        h=${size%x*}
+        w=${size#*x}
+        write_sim "$DIR/strong.sim" $mode $h $w
+        t1=""
+        for np in $(seq 1 "$MAX"); do
+            t=$(run $np "$DIR/strong.sim")
+            [ -z "$t1" ] && t1=$t
+            row strong $mode $np $h $w $t $t1
+        done
+    done
+
+    t1=""
+    for np in $(seq 1 "$MAX"); do
+        h=$((WEAK_ROWS * np))
+        write_sim "$DIR/weak.sim" $mode $h $WEAK_WIDTH
+        t=$(run $np "$DIR/weak.sim")
+        [ -z "$t1" ] && t1=$t
+        row weak $mode $np $h $WEAK_WIDTH $t $t1
+    done
+done
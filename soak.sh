@@ -0,0 +1,59 @@
+#!/bin/bash
+#
+# Memory soak of `make test`: every bundled .sim file, headless, for 100000 generations
+# with each engine that runs it. The run summary must report 0 allocations after
+# generation 1 and resident memory within SLACK KB of its size after generation 1. The
+# sparse engine allocates and frees tiles as the live area moves, so only its resident
+# memory is checked.
+#
+#     [MPIRUN=mpiexec] ./soak.sh [ranks] [generations]
+#
+
+NP=${1:-2}
+GENERATIONS=${2:-100000}
+SLACK=512
+FOREST=$(dirname "$0")/forest
+MPIRUN=${MPIRUN:-"mpirun --allow-run-as-root --oversubscribe"}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# soak file engine
+soak() {
+    local name
+    name="$(basename "$1" .sim): $2"
+    { cat "$1"; printf '\ndisplay:\n0\nseed:\n1\nengine:\n%s\n' "$2"; } | sed "8s/.*/$GENERATIONS/" > "$DIR/soak.sim"
+    if ! $MPIRUN -np "$NP" "$FOREST" "$DIR/soak.sim" > "$DIR/out" 2>&1; then
+        cat "$DIR/out"
+        echo "FAILED: $name exited with an error"
+        exit 1
+    fi
+    local after first last
+    after=$(sed -n 's/^Allocations: .* through generation 1, \([0-9]*\) after$/\1/p' "$DIR/out")
+    read -r first last < <(sed -n 's/^Resident: *\([0-9]*\) KB after generation 1, \([0-9]*\) KB after the last$/\1 \2/p' "$DIR/out")
+    if [ -z "$after" ] || [ -z "$first" ]; then
+        cat "$DIR/out"
+        echo "FAILED: $name printed no run summary"
+        exit 1
+    fi
+    if [ "$2" != sparse ] && [ "$after" != 0 ]; then
+        grep -E '^(Allocations|Resident):' "$DIR/out"
+        echo "FAILED: $name allocated $after times after generation 1"
+        exit 1
+    fi
+    if [ $((last - first)) -gt $SLACK ]; then
+        grep -E '^(Allocations|Resident):' "$DIR/out"
+        echo "FAILED: $name grew from $first KB to $last KB"
+        exit 1
+    fi
+    echo "ok    $name, $after allocations after generation 1, $first KB -> $last KB"
+}
+
+for f in "$(dirname "$0")"/simulations/*.sim; do
+    case $(sed -n 2p "$f") in
+        1) engines="node blocked frontier" ;;
+        2) engines="node blocked delta sparse" ;;
+        *) engines="blocked" ;;
+    esac
+    for e in $engines; do soak "$f" "$e"; done
+done
+echo "Memory flat over $GENERATIONS generations at $NP ranks"
@@ -0,0 +1,295 @@
+//
+// Unbounded Conway world of sparse tiles (engine: sparse).
+//
+// The world has no edges. It is a hash map of TILE x TILE bit-packed tiles, and each
+// tile belongs to the rank its coordinates hash to, so activity anywhere spreads over all
+// ranks. Every generation, each rank sends the edge cells of its tiles (a Border) to the
+// owners of the neighboring tiles that the edges touch, in one all-to-all. A tile is
+// allocated when a live edge of a neighbor reaches it, stepped 64 cells per word with
+// bit-sliced adders, and returned to the pool once it is empty, so memory follows the
+// live area. The .sim map is the initial soup, and the `height x width` box at the
+// origin is what the display shows of the world.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstring>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+
+/**
+ * Records bound for other ranks, grouped by rank. Filled in two passes over the same
+ * records: the first counts them, the second places them.
+ */
+template <class T>
+struct Outbox {
+    std::vector<T>* buf;
+    int* counts;     /* records per rank */
+    int* next;       /* next slot per rank */
+    bool counting;
+
+    void put(int rank, const T& t) {
+        if (counting) counts[rank]++;
+        else buf->at((unsigned long) next[rank]++) = t;
+    }
+};
+
+
+/**
+ * All-to-all of records. items(box) must put the same records in both passes.
+ * @param comm ranks
+ * @param items record source
+ * @param send send buffer
+ * @param recv received records
+ * @param a2a per-rank counts and offsets (4 per rank)
+ * @return bytes sent to other ranks
+ */
+template <class T, class F>
+static unsigned long exchange(MPI_Comm comm, F items, vector<T>* send, vector<T>* recv, vector<int>* a2a) {
+    int size, rank;
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_rank(comm, &rank);
+    int* send_counts = a2a->data();
+    int* send_displs = send_counts + size;
+    int* recv_counts = send_displs + size;
+    int* recv_displs = recv_counts + size;
+
+    Outbox<T> box = {send, send_counts, recv_displs, true};
+    fill(send_counts, send_counts + size, 0);
+    items(box);
+    int total = 0;
+    for (int r = 0; r < size; r++) { recv_displs[r] = total; total += send_counts[r]; }
+    send->resize((unsigned long) total);
+    box.counting = false;
+    items(box);
+
+    int bytes = (int) sizeof(T);
+    total = 0;
+    for (int r = 0; r < size; r++) {
+        send_counts[r] *= bytes;
+        send_displs[r] = total;
+        total += send_counts[r];
+    }
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+    total = 0;
+    for (int r = 0; r < size; r++) { recv_displs[r] = total; total += recv_counts[r]; }
+    recv->resize((unsigned long) total / sizeof(T));
+    MPI_Alltoallv(send->data(),send_counts,send_displs,MPI_BYTE,recv->data(),recv_counts,recv_displs,MPI_BYTE,comm);
+    return send->size() * sizeof(T) - (unsigned long) send_counts[rank];
+}
+
+
+/**
+ * Whether the edge of a tile touches a neighboring tile
+ * @param b edges of the tile
+ * @param dx column of the neighbor relative to the tile
+ * @param dy row of the neighbor relative to the tile
+ * @return bool
+ */
+static bool touches(const Border& b, int dx, int dy) {
+    if (dy == 0) return (dx < 0) ? b.left != 0 : b.right != 0;
+    unsigned long row = (dy < 0) ? b.top : b.bottom;
+    if (dx == 0) return row != 0;
+    return (dx < 0) ? (row & 1) != 0 : (row >> (TILE - 1)) != 0;
+}
+
+
+/**
+ * Adds a bit plane to a bit-sliced count of at most 8
+ * @param s count bits, lowest first
+ * @param x plane
+ */
+static void add_plane(unsigned long* s, unsigned long x) {
+    unsigned long c = s[0] & x;
+    s[0] ^= x;
+    x = s[1] & c;
+    s[1] ^= c;
+    c = s[2] & x;
+    s[2] ^= x;
+    s[3] |= c;
+}
+
+
+/**
+ * Rank that owns a tile
+ * @param x tile column
+ * @param y tile row
+ * @return int
+ */
+int State::tile_owner(long x, long y) {
+    unsigned long k = TileMap::key(x, y) * 0x9e3779b97f4a7c15UL;
+    return (int) ((k >> 32) % (unsigned long) _size);
+}
+
+
+/**
+ * Builds the world from the local strip: every live row word is sent to the owner of
+ * its tile
+ */
+void State::build_sparse() {
+    if (_sim->mode() != 2) fail(ERROR_ENGINE);
+    _world = new World();
+    _edges = new TileMap();
+    _border_out = new vector<Border>();
+    _border_in = new vector<Border>();
+    _patch_out = new vector<Patch>();
+    _patch_in = new vector<Patch>();
+    _a2a = new vector<int>((unsigned long) (4 * _size));
+
+    int rows = (_start < 0) ? 0 : _end - _start;
+    exchange(_comm, [&](Outbox<Patch>& box) {
+        for (int i = 0; i < rows; i++) {
+            long row = _start + i;
+            for (int x = 0; x * TILE < _width; x++) {
+                Patch p = {x, tile_of(row), row - tile_of(row) * TILE, 0};
+                for (int j = 0; j < TILE && x * TILE + j < _width; j++) {
+                    if (get_node_status(i, x * TILE + j) == 1) p.bits |= 1UL << j;
+                }
+                if (p.bits != 0) box.put(tile_owner(p.x, p.y), p);
+            }
+        }
+    }, _patch_out, _patch_in, _a2a);
+    for (const Patch& p : *_patch_in) _world->add(p.x, p.y)->rows[p.i] |= p.bits;
+}
+
+
+/**
+ * Sends the edges of every tile to the owners of the tiles they touch, and allocates the
+ * local tiles that a live edge reaches
+ */
+void State::transmit_sparse() {
+    _wire_sent += exchange(_comm, [&](Outbox<Border>& box) {
+        for (int k = 0; k < _world->size(); k++) {
+            Tile* t = _world->at(k);
+            Border b = {t->x, t->y, t->rows[0], t->rows[TILE - 1], 0, 0};
+            for (int i = 0; i < TILE; i++) {
+                b.left |= (t->rows[i] & 1) << i;
+                b.right |= (t->rows[i] >> (TILE - 1)) << i;
+            }
+            int owners[8];
+            int n = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if ((dx == 0 && dy == 0) || !touches(b, dx, dy)) continue;
+                    int r = tile_owner(t->x + dx, t->y + dy);
+                    if (find(owners, owners + n, r) == owners + n) owners[n++] = r;
+                }
+            }
+            for (int m = 0; m < n; m++) box.put(owners[m], b);
+        }
+    }, _border_out, _border_in, _a2a);
+    _wire_raw += _border_in->size() * 4 * TILE * sizeof(int);
+
+    _edges->clear();
+    for (int k = 0; k < (int) _border_in->size(); k++) {
+        const Border& b = _border_in->at((unsigned long) k);
+        _edges->put(b.x, b.y, k);
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if ((dx == 0 && dy == 0) || !touches(b, dx, dy)) continue;
+                if (tile_owner(b.x + dx, b.y + dy) == _rank) _world->add(b.x + dx, b.y + dy);
+            }
+        }
+    }
+}
+
+
+/**
+ * Advances every tile one generation, reading the neighbors' cells from the received
+ * edges, and frees the tiles left empty
+ */
+void State::step_sparse() {
+    Simulator* sim = _sim;
+    int u = (int) get<0>(sim->get_ctrlv()->at(0));
+    int o = (int) get<0>(sim->get_ctrlv()->at(1));
+    int g = (int) get<0>(sim->get_ctrlv()->at(2));
+
+    for (int k = 0; k < _world->size(); k++) {
+        Tile* t = _world->at(k);
+        const Border* near[3][3];
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int e = _edges->get(t->x + dx, t->y + dy);
+                near[dy + 1][dx + 1] = (e < 0) ? nullptr : &_border_in->at((unsigned long) e);
+            }
+        }
+        const Border* up = near[0][1];
+        const Border* down = near[2][1];
+        const Border* west = near[1][0];
+        const Border* east = near[1][2];
+
+        /* Rows -1 .. TILE with the cells left and right of them shifted in */
+        unsigned long mid[TILE + 2], w[TILE + 2], e[TILE + 2];
+        mid[0] = (up == nullptr) ? 0 : up->bottom;
+        mid[TILE + 1] = (down == nullptr) ? 0 : down->top;
+        memcpy(mid + 1, t->rows, sizeof(t->rows));
+        for (int i = 0; i < TILE + 2; i++) {
+            unsigned long wbit, ebit;
+            if (i == 0) {
+                wbit = (near[0][0] == nullptr) ? 0 : near[0][0]->bottom >> (TILE - 1);
+                ebit = (near[0][2] == nullptr) ? 0 : near[0][2]->bottom & 1;
+            }
+            else if (i == TILE + 1) {
+                wbit = (near[2][0] == nullptr) ? 0 : near[2][0]->top >> (TILE - 1);
+                ebit = (near[2][2] == nullptr) ? 0 : near[2][2]->top & 1;
+            }
+            else {
+                wbit = (west == nullptr) ? 0 : (west->right >> (i - 1)) & 1;
+                ebit = (east == nullptr) ? 0 : (east->left >> (i - 1)) & 1;
+            }
+            w[i] = (mid[i] << 1) | wbit;
+            e[i] = (mid[i] >> 1) | (ebit << (TILE - 1));
+        }
+
+        unsigned long next[TILE];
+        for (int i = 1; i <= TILE; i++) {
+            unsigned long s[4] = {0, 0, 0, 0};
+            for (unsigned long x : {w[i - 1], mid[i - 1], e[i - 1], w[i], e[i], w[i + 1], mid[i + 1], e[i + 1]}) add_plane(s, x);
+            unsigned long survive = 0, birth = 0;
+            for (int c = 0; c <= 8; c++) {
+                if (c != g && (c < u || c > o)) continue;
+                unsigned long eq = ~0UL;
+                for (int b = 0; b < 4; b++) eq &= ((c >> b) & 1) ? s[b] : ~s[b];
+                if (c == g) birth |= eq;
+                if (c >= u && c <= o) survive |= eq;
+            }
+            next[i - 1] = (mid[i] & survive) | (~mid[i] & birth);
+        }
+        memcpy(t->rows, next, sizeof(next));
+    }
+    _world->prune();
+}
+
+
+/**
+ * Copies the cells of the world inside the map box into the node rows for display: the
+ * owner of every tile row in the box sends it to the rank whose strip holds the row
+ */
+void State::sync_sparse() {
+    exchange(_comm, [&](Outbox<Patch>& box) {
+        for (int k = 0; k < _world->size(); k++) {
+            Tile* t = _world->at(k);
+            if (t->x < 0 || t->x * TILE >= _width) continue;
+            for (int i = 0; i < TILE; i++) {
+                long row = t->y * TILE + i;
+                if (row < 0 || row >= _height || t->rows[i] == 0) continue;
+                int r = 0;
+                while (get<1>(get_bounds(_size, r, _height)) <= row) r++;
+                Patch p = {t->x, t->y, i, t->rows[i]};
+                box.put(r, p);
+            }
+        }
+    }, _patch_out, _patch_in, _a2a);
+
+    int rows = (_start < 0) ? 0 : _end - _start;
+    fill(_strip->begin(), _strip->begin() + rows * _width, 0);
+    for (const Patch& p : *_patch_in) {
+        unsigned char* cells = _strip->data() + (p.y * TILE + p.i - _start) * _width;
+        for (int j = 0; j < TILE && p.x * TILE + j < _width; j++) cells[p.x * TILE + j] = (unsigned char) ((p.bits >> j) & 1);
+    }
+    for (int i = 0; i < rows; i++) _nodes->at((unsigned long) i)->set(_strip->data() + i * _width);
+}
@@ -0,0 +1,173 @@
+//
+// Steady-state and cycle detection (steady: stop / skip).
+//
+// After every step each rank hashes its strip row by row, every row keyed on its global
+// index, and one sum reduction combines the strips into a fingerprint of the whole map
+// that does not depend on the number of ranks. Conway's Game of Life is deterministic,
+// so a fingerprint seen again in the last `history` steps is a cycle: its period is the
+// distance between the two, its onset the earlier one. Once the period is known the run
+// stops, or skips whole periods up to the last generation, which leaves exactly the
+// state the full run would have ended in. Forest fire is random and never repeats by
+// chance; it settles only when nothing can change any more (no fire, and no tree that
+// lightning can strike or empty cell that can regrow), which is a period of 1.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+
+/**
+ * Hash of one row of cells
+ * @param cells first cell
+ * @param width cells in the row
+ * @param row global row, so that equal rows in different places hash differently
+ * @param counts cells per state, incremented
+ * @return unsigned long
+ */
+static unsigned long hash_row(const unsigned char* cells, int width, long row, unsigned long* counts) {
+    unsigned long h = 0x9e3779b97f4a7c15UL * (unsigned long) (row + 1);
+    for (int j = 0; j < width; j++) {
+        h = (h ^ cells[j]) * 0x100000001b3UL;
+        counts[cells[j]]++;
+    }
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9UL;
+    return h ^ (h >> 29);
+}
+
+
+/**
+ * Hash of one tile of the sparse engine
+ * @param t tile
+ * @param counts cells per state, incremented
+ * @return unsigned long
+ */
+static unsigned long hash_tile(const Tile* t, unsigned long* counts) {
+    unsigned long h = 0x9e3779b97f4a7c15UL * (TileMap::key(t->x, t->y) + 1);
+    for (int i = 0; i < TILE; i++) {
+        h = (h ^ t->rows[i]) * 0x100000001b3UL;
+        counts[1] += (unsigned long) __builtin_popcountl(t->rows[i]);
+    }
+    counts[0] += TILE * TILE;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9UL;
+    return h ^ (h >> 29);
+}
+
+
+/**
+ * Sizes the fingerprint history and takes the fingerprint of the initial map
+ * (generation 0)
+ */
+void State::init_steady() {
+    if (_steady == STEADY_OFF) return;
+    _hashes = new vector<unsigned long>((unsigned long) _history);
+    _hash_gens = new vector<int>((unsigned long) _history);
+    unsigned long sums[1 + VIEW_STATES];
+    fingerprint(sums);
+    _hashes->at(0) = sums[0];
+    _hash_gens->at(0) = 0;
+    _hash_count = 1;
+}
+
+
+/**
+ * Fingerprint of the current generation. Collective.
+ * @param sums hash of the map followed by its cells per state (same on every rank). The
+ * sparse engine counts the dead cells of the tiles it holds.
+ */
+void State::fingerprint(unsigned long* sums) {
+    unsigned long local[1 + VIEW_STATES] = {0};
+    if (_world != nullptr) {
+        for (int k = 0; k < _world->size(); k++) local[0] += hash_tile(_world->at(k), local + 1);
+        local[1] -= local[2];
+        MPI_Allreduce(local, sums, 1 + VIEW_STATES, MPI_UNSIGNED_LONG, MPI_SUM, _comm);
+        return;
+    }
+    for (int i = 0; i < _end - _start; i++) {
+        const unsigned char* cells;
+        if (_grid != nullptr) cells = _grid->row(i);
+        else {
+            for (int j = 0; j < _width; j++) _strip->at((unsigned long) j) = (unsigned char) get_node_status(i, j);
+            cells = _strip->data();
+        }
+        local[0] += hash_row(cells, _width, _start + i, local + 1);
+    }
+    MPI_Allreduce(local, sums, 1 + VIEW_STATES, MPI_UNSIGNED_LONG, MPI_SUM, _comm);
+}
+
+
+/**
+ * Looks for a steady state after a step, and once one is known, stops the run or jumps
+ * the current generation over as many whole periods as remain. Collective.
+ */
+void State::check_steady() {
+    int gen = _current + _step - 1;   /* generation just produced */
+    if (_period == 0) {
+        unsigned long sums[1 + VIEW_STATES];
+        fingerprint(sums);
+        Simulator* sim = _sim;
+        if (sim->mode() == 1) {
+            double ignition = sim->lightning_rate();   /* highest of the map with rasters */
+            double growth = sim->growth_rate();
+            bool settled = sums[3] == 0 && (ignition == 0 || sums[2] == 0) && (growth == 0 || sums[1] == 0);
+            if (settled) { _period = 1; _onset = gen; }
+        }
+        else {
+            long n = min(_hash_count, (long) _history);
+            for (long k = 1; k <= n && _period == 0; k++) {   /* most recent first: shortest period */
+                unsigned long at = (unsigned long) ((_hash_count - k) % _history);
+                if (_hashes->at(at) == sums[0]) {
+                    _onset = _hash_gens->at(at);
+                    _period = gen - _onset;
+                }
+            }
+            unsigned long at = (unsigned long) (_hash_count % _history);
+            _hashes->at(at) = sums[0];
+            _hash_gens->at(at) = gen;
+            _hash_count++;
+        }
+        if (_period == 0) return;
+    }
+
+    if (_steady == STEADY_STOP) _generations = gen;
+    else {
+        int jump = (_generations - gen) / _period * _period;
+        _current += jump;
+        _skipped += jump;
+    }
+}
+
+
+/**
+ * Checksums of the current generation for verification: one per band of rows, every row
+ * hashed as for the fingerprint, so that they depend only on the cells, not on the
+ * engine or the number of ranks. The sparse engine is read inside the map box. Collective.
+ * @param sums hash of each band of ceil(height / bands) rows, then of the whole map
+ * (same on every rank)
+ * @param bands bands
+ */
+void State::digest(unsigned long* sums, int bands) {
+    if (_engine == ENGINE_SPARSE) sync_sparse();
+    vector<unsigned long> local((unsigned long) bands + 1, 0);
+    unsigned long counts[VIEW_STATES] = {0};
+    int band = (_height + bands - 1) / bands;
+    for (int i = 0; _start >= 0 && i < _end - _start; i++) {
+        const unsigned char* cells;
+        if (_grid != nullptr) cells = _grid->row(i);
+        else if (_engine == ENGINE_SPARSE) cells = _strip->data() + i * _width;
+        else {
+            for (int j = 0; j < _width; j++) _strip->at((unsigned long) j) = (unsigned char) get_node_status(i, j);
+            cells = _strip->data();
+        }
+        unsigned long h = hash_row(cells, _width, _start + i, counts);
+        local[(unsigned long) ((_start + i) / band)] += h;
+        local[(unsigned long) bands] += h;
+    }
+    MPI_Allreduce(local.data(), sums, bands + 1, MPI_UNSIGNED_LONG, MPI_SUM, _comm);
+}
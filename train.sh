@@ -0,0 +1,32 @@
+#!/bin/bash
+#
+# Training workload of `make pgo`: every bundled .sim file, headless, with every engine,
+# halo backend and kernel that runs it, so that the profile covers the hot paths of each
+# (Larger than Life's sliding sums and the Conway lookup table included).
+#
+#     [MPIRUN=mpiexec] ./train.sh [ranks]
+#
+
+NP=${1:-2}
+FOREST=$(dirname "$0")/forest
+MPIRUN=${MPIRUN:-"mpirun --allow-run-as-root --oversubscribe"}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# run file options...
+run() {
+    { cat "$1"; printf '\nseed:\n1\ndisplay:\n0\nsteady:\noff\n'; shift; printf '%s\n' "$@"; } > "$DIR/train.sim"
+    $MPIRUN -np "$NP" "$FOREST" "$DIR/train.sim" > /dev/null || exit 1
+}
+
+for f in "$(dirname "$0")"/simulations/*.sim; do
+    mode=$(sed -n 2p "$f")
+    [ "$mode" = 3 ] || run "$f" engine: node
+    for halo in p2p shm rma; do run "$f" engine: blocked halo: $halo; done
+    if [ "$mode" = 1 ]; then run "$f" engine: frontier clusters: 10 "cluster file:" "$DIR/clusters.txt"
+    elif [ "$mode" = 2 ]; then
+        run "$f" engine: blocked kernel: table
+        run "$f" engine: delta
+        run "$f" engine: sparse
+    fi
+done
@@ -0,0 +1,136 @@
+//
+// Startup auto-tuning of the blocked engine (tune: on).
+//
+// The fastest tile edge, block depth (generations per halo exchange) and halo backend
+// depend on the map, the rule and the machine. Before the run, the ranks time a few
+// blocks of the actual map under each candidate, the halo backend first at the default
+// tile and depth and then every tile and depth with the fastest backend, and keep the
+// fastest. The choice is cached in the tuning file under (host, map size, mode, ranks),
+// so later runs of the same shape skip the search. Trials step copies of the map and
+// leave the run itself untouched.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+
+using namespace std;
+
+#define TUNE_GENERATIONS 16   /* generations timed per candidate, after one warm-up block */
+
+
+/**
+ * Times the blocked engine under the current tile, depth and halo backend on a fresh copy
+ * of the map. Collective.
+ * @return seconds per generation (slowest rank)
+ */
+double State::trial() {
+    int current = _current, generations = _generations;
+    unsigned long sent = _wire_sent, raw = _wire_raw;
+    build_grid();
+    _current = 1;
+    _generations = 2 * TUNE_GENERATIONS + _depth;
+    transmit_grid();
+    step_blocked();
+    _current += _step;
+
+    MPI_Barrier(_comm);
+    double t = MPI_Wtime();
+    int done = 0;
+    while (done < TUNE_GENERATIONS) {
+        transmit_grid();
+        step_blocked();
+        _current += _step;
+        done += _step;
+    }
+    t = (MPI_Wtime() - t) / done;
+    double slowest;
+    MPI_Allreduce(&t, &slowest, 1, MPI_DOUBLE, MPI_MAX, _comm);
+
+    free_grid();
+    _current = current;
+    _generations = generations;
+    _wire_sent = sent;
+    _wire_raw = raw;
+    _tune_trials++;
+    return slowest;
+}
+
+
+/**
+ * Sets the tile, depth and halo backend of the blocked engine from the tuning file, or
+ * searches for them and adds them to the file. Collective.
+ */
+void State::tune() {
+    double t = MPI_Wtime();
+    Simulator* sim = _sim;
+    char host[256] = "";
+    ostringstream key;
+    if (_rank == 0) {
+        gethostname(host, sizeof(host) - 1);
+        key << host << " " << _height << " " << _width << " " << sim->mode() << " " << _size;
+    }
+
+    /* Cached choice: key, then tile, depth, halo backend and microseconds per generation */
+    const char* backend[] = {"p2p", "shm", "rma"};
+    int found[4] = {0, _tile, _depth, _halo};
+    if (_rank == 0) {
+        ifstream in(_tune_file);
+        string line, name;
+        while (getline(in, line)) {
+            if (line.compare(0, key.str().size() + 1, key.str() + " ") != 0) continue;
+            istringstream values(line.substr(key.str().size()));
+            if (!(values >> found[1] >> found[2] >> name)) continue;
+            for (int h : {HALO_P2P, HALO_SHM, HALO_RMA}) if (name == backend[h]) { found[3] = h; found[0] = 1; }
+        }
+    }
+    MPI_Bcast(found, 4, MPI_INT, 0, _comm);
+    if (found[0]) {
+        _tile = found[1];
+        _depth = found[2];
+        _halo = found[3];
+        _tuned = TUNE_CACHED;
+        _tune_time = MPI_Wtime() - t;
+        return;
+    }
+
+    /* Halo backend at the default tile and depth; one rank has no halo */
+    int halo = _halo;
+    double best = 0;
+    if (min(_size, _height) > 1) {
+        for (int h : {HALO_P2P, HALO_SHM, HALO_RMA}) {
+            _halo = h;
+            double s = trial();
+            if (best == 0 || s < best) { best = s; halo = h; }
+        }
+    }
+    _halo = halo;
+
+    /* Tile and depth. Depths beyond the strip are capped, so stop at the first capped one. */
+    int tile = _tile, depth = _depth;
+    best = 0;
+    for (int d : {1, 2, 4, 8, 16}) {
+        _depth = d;
+        for (int e : {16, 32, 64, 128, 256}) {
+            if (e > 16 && e / 2 >= _width) break;
+            _tile = e;
+            double s = trial();
+            if (best == 0 || s < best) { best = s; tile = e; depth = _depth; }
+        }
+        if (_depth < d) break;
+    }
+    _tile = tile;
+    _depth = depth;
+    _tuned = TUNE_SEARCHED;
+
+    if (_rank == 0) {
+        ofstream out(_tune_file, ofstream::app);
+        out << key.str() << " " << _tile << " " << _depth << " " << backend[_halo] << " " << best * 1e6 << endl;
+    }
+    _tune_time = MPI_Wtime() - t;
+}
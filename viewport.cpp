@@ -0,0 +1,182 @@
+//
+// Downsampled display (viewport).
+//
+// When the map does not fit the terminal, every rank reduces its own strip to the
+// terminal's resolution: each screen cell stands for a block of map cells, and the rank
+// counts the states in each block it touches. Master gathers only those counts, adds the
+// partial blocks that straddle two strips, and picks one state per block. Master's work
+// and the gather volume per frame depend on the terminal size, not on the map size.
+//
+
+#include <mpi.h>
+#include <algorithm>
+#include "defs.h"
+#include "State.h"
+#include "Simulator.h"
+#include "Screen.h"
+
+using namespace std;
+
+
+/**
+ * @param n non-negative number
+ * @return decimal digits of n
+ */
+static int digits(int n) {
+    int d = 1;
+    while (n > 9) { n /= 10; d++; }
+    return d;
+}
+
+
+/**
+ * Viewport row of a map row
+ * @param row global map row
+ * @param rows viewport rows
+ * @param height map height
+ * @return int
+ */
+static int view_row(int row, int rows, int height) {
+    return (int) ((long) row * rows / height);
+}
+
+
+/**
+ * Agrees on the viewport chosen by master in init_window() and sizes the count buffers.
+ * Each rank holds counts for the viewport rows its strip touches; master also holds the
+ * gathered counts of every rank and their sum.
+ */
+void State::init_viewport() {
+    int view[3] = {_viewport, _view_h, _view_w};
+    MPI_Bcast(view, 3, MPI_INT, 0, _comm);
+    _viewport = view[0] != 0;
+    _view_h = view[1];
+    _view_w = view[2];
+    if (!_viewport) return;
+
+    _view_col = new vector<int>((unsigned long) _width);
+    for (int j = 0; j < _width; j++) _view_col->at((unsigned long) j) = (int) ((long) j * _view_w / _width);
+
+    int cells = _view_w * VIEW_STATES;
+    _view_lo = (_start < 0) ? 0 : view_row(_start, _view_h, _height);
+    int rows = (_start < 0) ? 0 : view_row(_end - 1, _view_h, _height) - _view_lo + 1;
+    _view_counts = new vector<int>((unsigned long) (rows * cells));
+
+    if (_rank == 0) {
+        _view_sizes = new vector<int>((unsigned long) _size);
+        _view_displs = new vector<int>((unsigned long) _size);
+        int total = 0;
+        for (int k = 0; k < _size; k++) {
+            tuple<int,int> bounds = get_bounds(_size, k, _height);
+            int n = 0;
+            if (get<0>(bounds) >= 0) {
+                n = view_row(get<1>(bounds) - 1, _view_h, _height) - view_row(get<0>(bounds), _view_h, _height) + 1;
+            }
+            _view_sizes->at((unsigned long) k) = n * cells;
+            _view_displs->at((unsigned long) k) = total;
+            total += n * cells;
+        }
+        _view_all = new vector<int>((unsigned long) total);
+        _view_sum = new vector<int>((unsigned long) (_view_h * cells));
+    }
+}
+
+
+/**
+ * Counts the states of the local strip per viewport block
+ */
+void State::reduce_strip() {
+    fill(_view_counts->begin(), _view_counts->end(), 0);
+    if (_start < 0) return;
+    int* counts = _view_counts->data();
+    const int* col = _view_col->data();
+    for (int i = 0; i < _end - _start; i++) {
+        int* row = counts + (view_row(_start + i, _view_h, _height) - _view_lo) * _view_w * VIEW_STATES;
+        if (_grid != nullptr) {
+            const unsigned char* cells = _grid->row(i);
+            for (int j = 0; j < _width; j++) row[col[j] * VIEW_STATES + cells[j]]++;
+        }
+        else {
+            for (int j = 0; j < _width; j++) row[col[j] * VIEW_STATES + get_node_status(i, j)]++;
+        }
+    }
+}
+
+
+/**
+ * Picks the state shown for a block
+ * @param counts state counts of the block
+ * @return the most common state (majority), or the highest state present (any), so that
+ * a single burning cell shows its whole block burning
+ */
+int State::reduce_block(const int* counts) {
+    int s = 0;
+    for (int k = 1; k < VIEW_STATES; k++) {
+        if (_reduce == REDUCE_ANY ? counts[k] > 0 : counts[k] >= counts[s]) s = k;
+    }
+    return s;
+}
+
+
+/**
+ * Displays the current generation at the viewport's resolution. Rows are labeled with
+ * the first map row and the rank of the block they show.
+ */
+void State::draw_viewport() {
+    reduce_strip();
+    int* all = (_rank == 0) ? _view_all->data() : nullptr;
+    int* sizes = (_rank == 0) ? _view_sizes->data() : nullptr;
+    int* displs = (_rank == 0) ? _view_displs->data() : nullptr;
+    MPI_Gatherv(_view_counts->data(),(int) _view_counts->size(),MPI_INT,all,sizes,displs,MPI_INT,0,_comm);
+    if (_rank != 0) return;
+
+    /* Add the partial blocks of every strip */
+    int cells = _view_w * VIEW_STATES;
+    fill(_view_sum->begin(), _view_sum->end(), 0);
+    for (int k = 0; k < _size; k++) {
+        tuple<int,int> bounds = get_bounds(_size, k, _height);
+        if (get<0>(bounds) < 0) continue;
+        int* sum = _view_sum->data() + view_row(get<0>(bounds), _view_h, _height) * cells;
+        const int* part = all + _view_displs->at((unsigned long) k);
+        for (int n = 0; n < _view_sizes->at((unsigned long) k); n++) sum[n] += part[n];
+    }
+
+    Simulator* sim = _sim;
+    int label = max(2, digits(_height));
+    int thread = 0;
+    _out.clear();
+    _screen->clear();
+
+    /* Row 0 */
+    _out += *this;
+    _screen->text(0, 0, _out.c_str(), _screen->cols());
+    _out += "\n";
+
+    for (int r = 0; r < _view_h; r++) {
+        int first = (int) (((long) r * _height + _view_h - 1) / _view_h);
+        while (get<1>(get_bounds(_size, thread, _height)) <= first) thread++;
+
+        unsigned long at = _out.length();
+        string number = to_string(first + 1);
+        _out.append((unsigned long) label - number.length(), '0');
+        _out += number;
+        _out += '|';
+        _screen->text(r + 1, 0, _out.c_str() + at);
+
+        const int* sum = _view_sum->data() + r * cells;
+        for (int c = 0; c < _view_w; c++) {
+            int s = reduce_block(sum + c * VIEW_STATES);
+            char ch = sim->translate(s);
+            _screen->cell(r + 1, label + 1 + c, ch, s);
+            _out += ch;
+        }
+
+        at = _out.length();
+        _out += "|T";
+        if (thread < 10) _out += '0';
+        _out += to_string(thread);
+        _screen->text(r + 1, label + 1 + _view_w, _out.c_str() + at);
+        _out += '\n';
+    }
+    _screen->show();
+}